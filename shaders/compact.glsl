@@ -0,0 +1,88 @@
+#version 430 core
+
+// Scatter surviving bodies to the front of the buffers using the scanned alive flags.
+// Slots past the survivors become massless and black, so the bodies can keep being stepped and drawn
+// with the old count until the host has read the new one back.
+
+layout(local_size_x = 128) in;
+
+layout(std430, binding = 0) buffer PositionsCompacted
+{
+    vec4 positions_and_masses_compacted[];
+};
+
+layout(std430, binding = 1) buffer VelocitiesCompacted
+{
+    vec4 velocities_compacted[];
+};
+
+layout(std430, binding = 2) buffer Colors
+{
+    vec4 colors[];
+};
+
+layout(std430, binding = 3) buffer PositionsMerged
+{
+    vec4 positions_and_masses_merged[];
+};
+
+layout(std430, binding = 4) buffer ColorsCompacted
+{
+    vec4 colors_compacted[];
+};
+
+layout(std430, binding = 5) buffer VelocitiesMerged
+{
+    vec4 velocities_merged[];
+};
+
+layout(std430, binding = 6) buffer Offsets
+{
+    uint offsets[];
+};
+
+// LiveCount of merging.hpp
+layout(std430, binding = 7) writeonly buffer LiveCount
+{
+    uvec3 step_groups; // indirect dispatch of one compute.glsl step over the survivors
+    uint live_count;
+};
+
+uniform uint count;
+
+void main()
+{
+    uint gid = gl_GlobalInvocationID.x;
+    if (gid >= count)
+    {
+        return;
+    }
+
+    // Last inclusive offset is the number of survivors
+    uint survivors = offsets[count - 1];
+    if (gid == count - 1)
+    {
+        step_groups = uvec3((survivors + 127) / 128, 1, 1);
+        live_count = survivors;
+    }
+
+    // Inclusive scan: a body survives if its offset is larger than the previous one
+    uint offset = offsets[gid];
+    uint previous = gid > 0 ? offsets[gid - 1] : 0u;
+    vec4 merged = positions_and_masses_merged[gid];
+    if (offset != previous)
+    {
+        uint dst = offset - 1;
+        positions_and_masses_compacted[dst] = merged;
+        velocities_compacted[dst] = velocities_merged[gid];
+        colors_compacted[dst] = colors[gid];
+    }
+
+    // Survivors only move down, every slot is read by its own invocation before this
+    if (gid >= survivors)
+    {
+        positions_and_masses_compacted[gid] = vec4(merged.xyz, 0.0);
+        positions_and_masses_merged[gid] = vec4(merged.xyz, 0.0);
+        colors_compacted[gid] = vec4(0.0);
+    }
+}
@@ -19,11 +19,15 @@ layout(std430, binding = 3) buffer PositionsOut
 
 shared vec4 local_positions_and_masses_in[128];
 
-uniform uint count;
-uniform float dt;
-uniform float gravity;
-uniform uint iter_per_frame;
-uniform float softening;
+layout(std140, binding = 0) uniform SimulationParameters
+{
+    uint count;
+    float dt;
+    float gravity;
+    float softening;
+    uint iter_per_frame;
+    uint step_count;
+};
 
 vec3 compute_acceleration(vec3 position, uint gid, uint tile_size)
 {
@@ -86,6 +90,6 @@ void main()
         // if (length(acceleration) < 0 || dt < 0) return;
     }
 
-    velocities[gid] = vec4(velocity, 0.0);
+    velocities[gid] = vec4(velocity, velocities[gid].w);
     positions_and_masses_out[gid] = vec4(position, mass);
 }
\ No newline at end of file
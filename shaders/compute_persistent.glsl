@@ -0,0 +1,177 @@
+#version 430 core
+
+// Persistent threads: one dispatch runs step_count steps. Workgroups stride over the bodies and meet
+// at a grid-wide barrier between two steps, which only completes when every workgroup is resident
+// at once: the group count has to stay small. A workgroup that waits more than SPIN_LIMIT polls sets
+// the failed flag and every workgroup gives up, the host checks the flag.
+// Positions ping-pong between bindings 0 and 3, after an odd step count the result is in binding 3.
+
+layout(local_size_x = 128) in;
+
+layout(std430, binding = 0) coherent buffer PositionsA
+{
+    vec4 positions_and_masses_a[];
+};
+
+layout(std430, binding = 1) buffer Velocities
+{
+    vec4 velocities[];
+};
+
+layout(std430, binding = 3) coherent buffer PositionsB
+{
+    vec4 positions_and_masses_b[];
+};
+
+// Grid barrier state, arrived is back to 0 after every barrier. failed stays set until the host resets it.
+layout(std430, binding = 4) coherent buffer GridSync
+{
+    uint arrived;
+    uint generation;
+    uint failed;
+};
+
+const uint SPIN_LIMIT = 1u << 20;
+
+shared vec4 local_positions_and_masses[128];
+shared bool grid_failed;
+
+layout(std140, binding = 0) uniform SimulationParameters
+{
+    uint count;
+    float dt;
+    float gravity;
+    float softening;
+    uint iter_per_frame;
+    uint step_count;
+};
+
+vec4 load_body(uint i, bool from_a)
+{
+    return from_a ? positions_and_masses_a[i] : positions_and_masses_b[i];
+}
+
+// Same tiled sum as compute.glsl, the results match it bit for bit
+vec3 compute_acceleration(vec3 position, uint gid, bool from_a)
+{
+    vec3 acceleration = vec3(0.0);
+    uint tid = gl_LocalInvocationID.x;
+    uint num_tiles = (count + 127) / 128;
+
+    for (uint tile = 0; tile < num_tiles; ++tile)
+    {
+        uint idx = tile * 128 + tid;
+        if (idx < count)
+        {
+            local_positions_and_masses[tid] = load_body(idx, from_a);
+        }
+        barrier();
+
+        uint tile_end = min(128u, count - tile * 128);
+        for (uint j = 0; j < tile_end; ++j)
+        {
+            if (tile * 128 + j == gid)
+            {
+                continue;
+            }
+
+            vec3 dpos = local_positions_and_masses[j].xyz - position;
+            float eps_sq = softening * softening;
+            float distance_sq = dot(dpos, dpos) + eps_sq;
+
+            float inv_r = inversesqrt(distance_sq);
+            float inv_r3 = inv_r * inv_r * inv_r;
+            acceleration += gravity * local_positions_and_masses[j].w * dpos * inv_r3;
+        }
+        barrier();
+    }
+
+    return acceleration;
+}
+
+// Wait until every workgroup finished the step, their writes are then visible.
+// False if the barrier failed, in this workgroup or another one.
+bool grid_barrier()
+{
+    memoryBarrierBuffer();
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        // The generation has to be read before arriving, the last one to arrive bumps it
+        uint current = atomicAdd(generation, 0u);
+        bool released = false;
+        if (atomicAdd(arrived, 1u) == gl_NumWorkGroups.x - 1)
+        {
+            atomicExchange(arrived, 0u);
+            atomicAdd(generation, 1u);
+            released = true;
+        }
+        else
+        {
+            // Bounded: a workgroup that is not resident would keep this one spinning forever.
+            // Also ends early when llvmpipe cuts the loop, released then stays false.
+            for (uint spin = 0; spin < SPIN_LIMIT && !released && atomicAdd(failed, 0u) == 0u; ++spin)
+            {
+                released = atomicAdd(generation, 0u) != current;
+            }
+        }
+
+        if (!released)
+        {
+            atomicExchange(failed, 1u);
+        }
+        grid_failed = atomicAdd(failed, 0u) != 0u;
+    }
+
+    barrier();
+    memoryBarrierBuffer();
+    return !grid_failed;
+}
+
+void main()
+{
+    uint tid = gl_LocalInvocationID.x;
+    uint stride = gl_NumWorkGroups.x * 128;
+
+    for (uint step = 0; step < step_count; ++step)
+    {
+        bool from_a = (step & 1u) == 0u;
+
+        // Every invocation of the workgroup takes part in the tile loop
+        for (uint base = gl_WorkGroupID.x * 128; base < count; base += stride)
+        {
+            uint gid = base + tid;
+            uint idx = min(gid, count - 1);
+
+            vec4 body = load_body(idx, from_a);
+            vec3 position = body.xyz;
+            vec3 velocity = velocities[idx].xyz;
+
+            for (uint i = 0; i < iter_per_frame; ++i)
+            {
+                vec3 acceleration = compute_acceleration(position, gid, from_a);
+                velocity += acceleration * dt;
+                position += velocity * dt;
+            }
+
+            if (gid < count)
+            {
+                velocities[gid] = vec4(velocity, velocities[gid].w);
+                if (from_a)
+                {
+                    positions_and_masses_b[gid] = vec4(position, body.w);
+                }
+                else
+                {
+                    positions_and_masses_a[gid] = vec4(position, body.w);
+                }
+            }
+        }
+
+        if (!grid_barrier())
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#version 430 core
+
+// compute.glsl with per body softening lengths and the energies of every body, from the same pair loop.
+// The softening length of a body is the w lane of its velocity, 0 for the global softening. A pair is
+// softened with eps_ij^2 = (eps_i^2 + eps_j^2) / 2, so the forces between two bodies stay opposite.
+// The energies are those of the positions the step starts from:
+// energies[i].x: potential, -G sum m_j / r_ij
+// energies[i].y: kinetic energy, with the velocity halfway through the kick as in leapfrog
+
+layout(local_size_x = 128) in;
+
+layout(std430, binding = 0) buffer PositionsIn
+{
+    vec4 positions_and_masses_in[];
+};
+
+layout(std430, binding = 1) buffer Velocities
+{
+    vec4 velocities[];
+};
+
+layout(std430, binding = 3) buffer PositionsOut
+{
+    vec4 positions_and_masses_out[];
+};
+
+layout(std430, binding = 4) buffer Energies
+{
+    vec2 energies[];
+};
+
+shared vec4 local_positions_and_masses_in[128];
+shared float local_half_softening_sq[128];
+
+layout(std140, binding = 0) uniform SimulationParameters
+{
+    uint count;
+    float dt;
+    float gravity;
+    float softening;
+    uint iter_per_frame;
+    uint step_count;
+};
+
+// Half the squared softening length, other invocations write their velocity during the step but keep its w lane
+float half_softening_sq_of(uint idx)
+{
+    float length = velocities[idx].w > 0.0 ? velocities[idx].w : softening;
+    return 0.5 * length * length;
+}
+
+// Acceleration in xyz, sum of m_j / r_ij in w
+vec4 compute_acceleration_and_potential(vec3 position, float own_half_softening_sq, uint gid)
+{
+    vec3 acceleration = vec3(0.0);
+    float potential = 0.0;
+    uint tid = gl_LocalInvocationID.x;
+    uint num_tiles = (count + 127) / 128;
+
+    for (uint tile = 0; tile < num_tiles; ++tile)
+    {
+        uint idx = tile * 128 + tid;
+        if (idx < count)
+        {
+            local_positions_and_masses_in[tid] = positions_and_masses_in[idx];
+            local_half_softening_sq[tid] = half_softening_sq_of(idx);
+        }
+        barrier();
+
+        uint tile_end = min(128u, count - tile * 128);
+        for (uint j = 0; j < tile_end; ++j)
+        {
+            if (tile * 128 + j == gid)
+            {
+                continue;
+            }
+
+            vec3 dpos = local_positions_and_masses_in[j].xyz - position;
+            float distance_sq = dot(dpos, dpos) + (own_half_softening_sq + local_half_softening_sq[j]);
+
+            float inv_r = inversesqrt(distance_sq);
+            float m_inv_r = local_positions_and_masses_in[j].w * inv_r;
+            acceleration += m_inv_r * inv_r * inv_r * dpos;
+            potential += m_inv_r;
+        }
+        barrier();
+    }
+
+    return vec4(gravity * acceleration, potential);
+}
+
+void main()
+{
+    // Invocations past the count still load their tiles
+    uint gid = gl_GlobalInvocationID.x;
+    bool in_range = gid < count;
+    uint idx = min(gid, count - 1);
+
+    vec3 position = positions_and_masses_in[idx].xyz;
+    float mass = positions_and_masses_in[idx].w;
+    vec4 velocity_and_softening = velocities[idx];
+    vec3 velocity = velocity_and_softening.xyz;
+    float own_half_softening_sq = half_softening_sq_of(idx);
+
+    vec4 acceleration_and_potential = vec4(0.0);
+    vec3 synchronised_velocity = velocity;
+    for (uint i = 0; i < iter_per_frame; ++i)
+    {
+        acceleration_and_potential = compute_acceleration_and_potential(position, own_half_softening_sq, gid);
+        synchronised_velocity = velocity + 0.5 * acceleration_and_potential.xyz * dt;
+        velocity += acceleration_and_potential.xyz * dt;
+        position += velocity * dt;
+    }
+
+    if (in_range)
+    {
+        energies[gid] = vec2(-gravity * acceleration_and_potential.w, 0.5 * mass * dot(synchronised_velocity, synchronised_velocity));
+        velocities[gid] = vec4(velocity, velocity_and_softening.w);
+        positions_and_masses_out[gid] = vec4(position, mass);
+    }
+}
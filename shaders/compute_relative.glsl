@@ -0,0 +1,158 @@
+#version 430 core
+
+// Cell-relative integration. A position is cell * cell_size + offset, cell_size being a power of two,
+// so cell differences convert to float exactly and dpos only rounds once, at the scale of the
+// offsets instead of the scale of the scene. Accelerations are summed with Kahan compensation.
+// Stage 0: split absolute positions into cells and offsets
+// Stage 1: integrate, write the next cells and offsets and the absolute positions for rendering
+
+layout(local_size_x = 128) in;
+
+layout(std430, binding = 0) buffer PositionsIn
+{
+    vec4 positions_and_masses_in[];
+};
+
+layout(std430, binding = 1) buffer Velocities
+{
+    vec4 velocities[];
+};
+
+layout(std430, binding = 3) buffer PositionsOut
+{
+    vec4 positions_and_masses_out[];
+};
+
+layout(std430, binding = 4) buffer CellsIn
+{
+    ivec4 cells_in[];
+};
+
+layout(std430, binding = 5) buffer OffsetsIn
+{
+    vec4 offsets_and_masses_in[];
+};
+
+layout(std430, binding = 6) buffer CellsOut
+{
+    ivec4 cells_out[];
+};
+
+layout(std430, binding = 7) buffer OffsetsOut
+{
+    vec4 offsets_and_masses_out[];
+};
+
+shared ivec4 local_cells[128];
+shared vec4 local_offsets_and_masses[128];
+
+uniform uint count;
+uniform uint stage;
+uniform float dt;
+uniform float gravity;
+uniform float softening;
+uniform float cell_size;
+
+// Nearest cell, the offset stays within half a cell
+ivec3 nearest_cell(vec3 position)
+{
+    return ivec3(floor(position / cell_size + 0.5));
+}
+
+vec3 compute_acceleration(ivec3 cell, vec3 offset, uint gid)
+{
+    precise vec3 acceleration = vec3(0.0);
+    precise vec3 compensation = vec3(0.0);
+    float eps_sq = softening * softening;
+    uint tid = gl_LocalInvocationID.x;
+    uint num_tiles = (count + 127) / 128;
+
+    for (uint tile = 0; tile < num_tiles; ++tile)
+    {
+        uint idx = tile * 128 + tid;
+        if (idx < count)
+        {
+            local_cells[tid] = cells_in[idx];
+            local_offsets_and_masses[tid] = offsets_and_masses_in[idx];
+        }
+        barrier();
+
+        uint tile_end = min(128u, count - tile * 128);
+        for (uint j = 0; j < tile_end; ++j)
+        {
+            if (tile * 128 + j == gid)
+            {
+                continue;
+            }
+
+            vec3 dpos = vec3(local_cells[j].xyz - cell) * cell_size + (local_offsets_and_masses[j].xyz - offset);
+            float distance_sq = dot(dpos, dpos) + eps_sq;
+
+            float inv_r = inversesqrt(distance_sq);
+            float inv_r3 = inv_r * inv_r * inv_r;
+
+            // Kahan summation
+            precise vec3 term = gravity * local_offsets_and_masses[j].w * dpos * inv_r3 - compensation;
+            precise vec3 sum = acceleration + term;
+            compensation = (sum - acceleration) - term;
+            acceleration = sum;
+        }
+        barrier();
+    }
+
+    return acceleration;
+}
+
+void split_positions(uint gid)
+{
+    if (gid >= count)
+    {
+        return;
+    }
+
+    vec4 body = positions_and_masses_in[gid];
+    ivec3 cell = nearest_cell(body.xyz);
+    cells_in[gid] = ivec4(cell, 0);
+    offsets_and_masses_in[gid] = vec4(body.xyz - vec3(cell) * cell_size, body.w);
+}
+
+void integrate(uint gid)
+{
+    // Every invocation takes part in the tile loop
+    bool in_range = gid < count;
+    uint idx = min(gid, count - 1);
+
+    ivec3 cell = cells_in[idx].xyz;
+    vec3 offset = offsets_and_masses_in[idx].xyz;
+    float mass = offsets_and_masses_in[idx].w;
+    vec3 velocity = velocities[idx].xyz;
+
+    vec3 acceleration = compute_acceleration(cell, offset, gid);
+    velocity += acceleration * dt;
+    offset += velocity * dt;
+
+    // Move to the neighbouring cell once the body left its own
+    ivec3 shift = nearest_cell(offset);
+    cell += shift;
+    offset -= vec3(shift) * cell_size;
+
+    if (in_range)
+    {
+        velocities[gid] = vec4(velocity, velocities[gid].w);
+        cells_out[gid] = ivec4(cell, 0);
+        offsets_and_masses_out[gid] = vec4(offset, mass);
+        positions_and_masses_out[gid] = vec4(vec3(cell) * cell_size + offset, mass);
+    }
+}
+
+void main()
+{
+    if (stage == 0)
+    {
+        split_positions(gl_GlobalInvocationID.x);
+    }
+    else
+    {
+        integrate(gl_GlobalInvocationID.x);
+    }
+}
@@ -0,0 +1,173 @@
+#version 430 core
+
+// Conservation diagnostics with workgroup tree reductions.
+// Per workgroup and in the final result, 4 vec4:
+// [0] kinetic energy, potential energy, mass, 0
+// [1] linear momentum, 0
+// [2] angular momentum, 0
+// [3] mass weighted position, 0
+// With force_pass_energies, the energies are summed from those compute_potential.glsl wrote in its
+// step, instead of a second pair loop here.
+
+layout(local_size_x = 128) in;
+
+layout(std430, binding = 0) buffer PositionsIn
+{
+    vec4 positions_and_masses_in[];
+};
+
+layout(std430, binding = 1) buffer Velocities
+{
+    vec4 velocities[];
+};
+
+layout(std430, binding = 4) buffer Partials
+{
+    vec4 partials[];
+};
+
+layout(std430, binding = 5) buffer Results
+{
+    vec4 results[4];
+};
+
+layout(std430, binding = 6) buffer Energies
+{
+    vec2 energies[];
+};
+
+shared vec4 local_positions_and_masses_in[128];
+shared vec4 local_sums[4][128];
+
+uniform uint count;
+uniform uint stage;
+uniform uint num_partials;
+uniform float gravity;
+uniform float softening;
+uniform uint force_pass_energies;
+
+// Same tiled pair loop as compute.glsl, sum of m_j / r_ij
+float compute_potential(vec3 position, uint gid)
+{
+    float potential = 0.0;
+    float eps_sq = softening * softening;
+    uint tid = gl_LocalInvocationID.x;
+    uint num_tiles = (count + 127) / 128;
+
+    for (uint tile = 0; tile < num_tiles; ++tile)
+    {
+        uint idx = tile * 128 + tid;
+        if (idx < count)
+        {
+            local_positions_and_masses_in[tid] = positions_and_masses_in[idx];
+        }
+        barrier();
+
+        uint tile_end = min(128u, count - tile * 128);
+        for (uint j = 0; j < tile_end; ++j)
+        {
+            if (tile * 128 + j == gid)
+            {
+                continue;
+            }
+
+            vec3 dpos = local_positions_and_masses_in[j].xyz - position;
+            potential += local_positions_and_masses_in[j].w * inversesqrt(dot(dpos, dpos) + eps_sq);
+        }
+        barrier();
+    }
+
+    return potential;
+}
+
+void reduce_local_sums(uint tid)
+{
+    barrier();
+    for (uint stride = 64; stride > 0; stride >>= 1)
+    {
+        if (tid < stride)
+        {
+            for (uint k = 0; k < 4; ++k)
+            {
+                local_sums[k][tid] += local_sums[k][tid + stride];
+            }
+        }
+        barrier();
+    }
+}
+
+// Stage 0: per body quantities, reduced per workgroup
+void reduce_bodies(uint gid, uint tid)
+{
+    bool in_range = gid < count;
+    vec4 body = in_range ? positions_and_masses_in[gid] : vec4(0.0);
+    vec3 velocity = in_range ? velocities[gid].xyz : vec3(0.0);
+    float mass = body.w;
+
+    // Each pair is seen twice in the potential, hence its 0.5
+    if (force_pass_energies != 0)
+    {
+        vec2 energy = in_range ? energies[gid] : vec2(0.0);
+        local_sums[0][tid] = vec4(energy.y, 0.5 * mass * energy.x, mass, 0.0);
+    }
+    else
+    {
+        float potential = compute_potential(body.xyz, gid);
+        local_sums[0][tid] = vec4(0.5 * mass * dot(velocity, velocity), -0.5 * gravity * mass * potential, mass, 0.0);
+    }
+    local_sums[1][tid] = vec4(mass * velocity, 0.0);
+    local_sums[2][tid] = vec4(mass * cross(body.xyz, velocity), 0.0);
+    local_sums[3][tid] = vec4(mass * body.xyz, 0.0);
+
+    reduce_local_sums(tid);
+
+    if (tid == 0)
+    {
+        for (uint k = 0; k < 4; ++k)
+        {
+            partials[gl_WorkGroupID.x * 4 + k] = local_sums[k][0];
+        }
+    }
+}
+
+// Stage 1: a single workgroup reduces the partial sums
+void reduce_partials(uint tid)
+{
+    vec4 sums[4] = vec4[4](vec4(0.0), vec4(0.0), vec4(0.0), vec4(0.0));
+    for (uint i = tid; i < num_partials; i += 128)
+    {
+        for (uint k = 0; k < 4; ++k)
+        {
+            sums[k] += partials[i * 4 + k];
+        }
+    }
+
+    for (uint k = 0; k < 4; ++k)
+    {
+        local_sums[k][tid] = sums[k];
+    }
+
+    reduce_local_sums(tid);
+
+    if (tid == 0)
+    {
+        for (uint k = 0; k < 4; ++k)
+        {
+            results[k] = local_sums[k][0];
+        }
+    }
+}
+
+void main()
+{
+    uint tid = gl_LocalInvocationID.x;
+
+    if (stage == 0)
+    {
+        reduce_bodies(gl_GlobalInvocationID.x, tid);
+    }
+    else
+    {
+        reduce_partials(tid);
+    }
+}
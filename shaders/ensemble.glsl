@@ -0,0 +1,106 @@
+#version 430 core
+
+// Many independent simulations packed in the same buffers.
+// Workgroup (x, y) handles bodies [x * 128, x * 128 + 128) of simulation y, the tile loop
+// only ever reads bodies of that simulation.
+
+layout(local_size_x = 128) in;
+
+struct Simulation
+{
+    uint offset;
+    uint count;
+    float gravity;
+    float softening;
+};
+
+layout(std430, binding = 0) buffer PositionsIn
+{
+    vec4 positions_and_masses_in[];
+};
+
+layout(std430, binding = 1) buffer Velocities
+{
+    vec4 velocities[];
+};
+
+layout(std430, binding = 3) buffer PositionsOut
+{
+    vec4 positions_and_masses_out[];
+};
+
+layout(std430, binding = 4) buffer Simulations
+{
+    Simulation simulations[];
+};
+
+shared vec4 local_positions_and_masses_in[128];
+
+uniform float dt;
+
+vec3 compute_acceleration(vec3 position, uint local_id, Simulation sim)
+{
+    vec3 acceleration = vec3(0.0);
+    float eps_sq = sim.softening * sim.softening;
+    uint num_tiles = (sim.count + 127) / 128;
+
+    for (uint tile = 0; tile < num_tiles; ++tile)
+    {
+        uint tid = gl_LocalInvocationID.x;
+        uint idx = tile * 128 + tid;
+
+        if (idx < sim.count)
+        {
+            local_positions_and_masses_in[tid] = positions_and_masses_in[sim.offset + idx];
+        }
+        barrier();
+
+        uint tile_end = min(128u, sim.count - tile * 128);
+        for (uint j = 0; j < tile_end; ++j)
+        {
+            if (tile * 128 + j == local_id)
+            {
+                continue;
+            }
+
+            vec3 dpos = local_positions_and_masses_in[j].xyz - position;
+            float distance_sq = dot(dpos, dpos) + eps_sq;
+
+            float inv_r = inversesqrt(distance_sq);
+            float inv_r3 = inv_r * inv_r * inv_r;
+            acceleration += sim.gravity * local_positions_and_masses_in[j].w * dpos * inv_r3;
+        }
+        barrier();
+    }
+
+    return acceleration;
+}
+
+void main()
+{
+    Simulation sim = simulations[gl_WorkGroupID.y];
+
+    // Whole workgroup past the end of its simulation, uniform exit
+    if (gl_WorkGroupID.x * 128 >= sim.count)
+    {
+        return;
+    }
+
+    uint local_id = gl_WorkGroupID.x * 128 + gl_LocalInvocationID.x;
+    bool is_active = local_id < sim.count;
+    uint gid = sim.offset + min(local_id, sim.count - 1);
+
+    vec3 position = positions_and_masses_in[gid].xyz;
+    float mass = positions_and_masses_in[gid].w;
+    vec3 velocity = velocities[gid].xyz;
+
+    vec3 acceleration = compute_acceleration(position, local_id, sim);
+    velocity += acceleration * dt;
+    position += velocity * dt;
+
+    if (is_active)
+    {
+        velocities[gid] = vec4(velocity, velocities[gid].w);
+        positions_and_masses_out[gid] = vec4(position, mass);
+    }
+}
@@ -0,0 +1,171 @@
+#version 430 core
+
+layout(local_size_x = 128) in;
+
+layout(std430, binding = 0) buffer PositionsIn
+{
+    vec4 positions_and_masses_in[];
+};
+
+layout(std430, binding = 1) buffer Velocities
+{
+    vec4 velocities[];
+};
+
+layout(std430, binding = 3) buffer PositionsOut
+{
+    vec4 positions_and_masses_out[];
+};
+
+layout(std430, binding = 4) buffer MergeTargets
+{
+    uint merge_targets[];
+};
+
+layout(std430, binding = 5) buffer VelocitiesOut
+{
+    vec4 velocities_out[];
+};
+
+layout(std430, binding = 6) buffer AliveFlags
+{
+    uint alive_flags[];
+};
+
+shared vec4 local_positions_and_masses_in[128];
+shared uint local_merge_targets[128];
+
+uniform uint count;
+uniform float merge_radius;
+uniform uint stage;
+
+const uint NO_TARGET = 0xFFFFFFFFu;
+
+// Heavier body wins, ties are broken by the lowest index
+bool outranks(float mass_a, uint a, float mass_b, uint b)
+{
+    return mass_a > mass_b || (mass_a == mass_b && a < b);
+}
+
+// Stage 0: every body looks for the heaviest body within merge_radius that outranks it
+void find_merge_targets(uint gid, bool is_active)
+{
+    vec4 self = is_active ? positions_and_masses_in[gid] : vec4(0.0);
+    float radius_sq = merge_radius * merge_radius;
+
+    uint target = NO_TARGET;
+    float target_mass = 0.0;
+
+    uint tid = gl_LocalInvocationID.x;
+    uint num_tiles = (count + 127) / 128;
+
+    for (uint tile = 0; tile < num_tiles; ++tile)
+    {
+        uint idx = tile * 128 + tid;
+        if (idx < count)
+        {
+            local_positions_and_masses_in[tid] = positions_and_masses_in[idx];
+        }
+        barrier();
+
+        uint tile_end = min(128u, count - tile * 128);
+        for (uint j = 0; j < tile_end && is_active; ++j)
+        {
+            uint other = tile * 128 + j;
+            vec4 other_body = local_positions_and_masses_in[j];
+            vec3 dpos = other_body.xyz - self.xyz;
+
+            if (other == gid || dot(dpos, dpos) >= radius_sq || !outranks(other_body.w, other, self.w, gid))
+            {
+                continue;
+            }
+
+            if (target == NO_TARGET || outranks(other_body.w, other, target_mass, target))
+            {
+                target = other;
+                target_mass = other_body.w;
+            }
+        }
+        barrier();
+    }
+
+    if (is_active)
+    {
+        merge_targets[gid] = target;
+    }
+}
+
+// Stage 1: roots gather the bodies pointing at them, conserving mass and momentum.
+// A body whose target is not a root itself waits for a later merge pass.
+void merge_into_roots(uint gid, bool is_active)
+{
+    uint own_target = is_active ? merge_targets[gid] : NO_TARGET;
+    bool is_root = own_target == NO_TARGET;
+    bool absorbed = !is_root && merge_targets[own_target] == NO_TARGET;
+
+    vec4 self = is_active ? positions_and_masses_in[gid] : vec4(0.0);
+    vec4 velocity = is_active ? velocities[gid] : vec4(0.0);
+
+    float mass = self.w;
+    vec3 weighted_position = self.w * self.xyz;
+    vec3 momentum = self.w * velocity.xyz;
+
+    uint tid = gl_LocalInvocationID.x;
+    uint num_tiles = (count + 127) / 128;
+
+    for (uint tile = 0; tile < num_tiles; ++tile)
+    {
+        uint idx = tile * 128 + tid;
+        if (idx < count)
+        {
+            local_positions_and_masses_in[tid] = positions_and_masses_in[idx];
+            local_merge_targets[tid] = merge_targets[idx];
+        }
+        barrier();
+
+        uint tile_end = min(128u, count - tile * 128);
+        for (uint j = 0; j < tile_end && is_active && is_root; ++j)
+        {
+            if (local_merge_targets[j] != gid)
+            {
+                continue;
+            }
+
+            uint other = tile * 128 + j;
+            vec4 other_body = local_positions_and_masses_in[j];
+            mass += other_body.w;
+            weighted_position += other_body.w * other_body.xyz;
+            momentum += other_body.w * velocities[other].xyz;
+        }
+        barrier();
+    }
+
+    // Massless bodies are the slots a previous compaction emptied, they are dropped
+    if (is_active && mass > 0.0)
+    {
+        positions_and_masses_out[gid] = vec4(weighted_position / mass, mass);
+        velocities_out[gid] = vec4(momentum / mass, velocity.w);
+        alive_flags[gid] = absorbed ? 0u : 1u;
+    }
+    else if (is_active)
+    {
+        positions_and_masses_out[gid] = self;
+        velocities_out[gid] = velocity;
+        alive_flags[gid] = 0u;
+    }
+}
+
+void main()
+{
+    uint gid = gl_GlobalInvocationID.x;
+    bool is_active = gid < count;
+
+    if (stage == 0)
+    {
+        find_merge_targets(gid, is_active);
+    }
+    else
+    {
+        merge_into_roots(gid, is_active);
+    }
+}
@@ -0,0 +1,24 @@
+#version 460 core
+
+layout(std430, binding = 4) buffer Accumulation
+{
+    uint accumulation[];
+};
+
+out vec4 frag_color;
+
+uniform uvec2 resolution;
+uniform float exposure;
+
+const float FIXED_POINT_SCALE = 256.0;
+
+void main()
+{
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    uint index = 4 * (pixel.y * resolution.x + pixel.x);
+
+    vec3 color = vec3(accumulation[index + 0], accumulation[index + 1], accumulation[index + 2]) / FIXED_POINT_SCALE;
+
+    // Exponential tonemap keeps dense cores from clipping to white
+    frag_color = vec4(1.0 - exp(-exposure * color), 1.0);
+}
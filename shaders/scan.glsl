@@ -0,0 +1,98 @@
+#version 430 core
+
+// Inclusive prefix sum over blocks of 1024 values (256 threads x 4 values)
+
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 6) buffer Values
+{
+    uint values[];
+};
+
+layout(std430, binding = 7) buffer BlockSums
+{
+    uint block_sums[];
+};
+
+shared uint local_sums[256];
+
+uniform uint count;
+uniform uint stage;
+
+const uint VALUES_PER_THREAD = 4;
+
+// Stage 0: scan each block in place and write its total to block_sums
+void scan_block()
+{
+    uint tid = gl_LocalInvocationID.x;
+    uint base = gl_WorkGroupID.x * 256 * VALUES_PER_THREAD + tid * VALUES_PER_THREAD;
+
+    uint running_sums[VALUES_PER_THREAD];
+    uint running = 0;
+    for (uint k = 0; k < VALUES_PER_THREAD; ++k)
+    {
+        uint idx = base + k;
+        running += idx < count ? values[idx] : 0u;
+        running_sums[k] = running;
+    }
+
+    local_sums[tid] = running;
+    barrier();
+
+    // Hillis-Steele scan over the per-thread totals
+    for (uint offset = 1; offset < 256; offset <<= 1)
+    {
+        uint value = tid >= offset ? local_sums[tid - offset] : 0u;
+        barrier();
+        local_sums[tid] += value;
+        barrier();
+    }
+
+    uint prefix = tid > 0 ? local_sums[tid - 1] : 0u;
+    for (uint k = 0; k < VALUES_PER_THREAD; ++k)
+    {
+        uint idx = base + k;
+        if (idx < count)
+        {
+            values[idx] = running_sums[k] + prefix;
+        }
+    }
+
+    if (tid == 255)
+    {
+        block_sums[gl_WorkGroupID.x] = local_sums[255];
+    }
+}
+
+// Stage 1: add the scanned total of all previous blocks
+void add_block_offsets()
+{
+    uint block = gl_WorkGroupID.x;
+    if (block == 0)
+    {
+        return;
+    }
+
+    uint prefix = block_sums[block - 1];
+    uint base = block * 256 * VALUES_PER_THREAD + gl_LocalInvocationID.x * VALUES_PER_THREAD;
+    for (uint k = 0; k < VALUES_PER_THREAD; ++k)
+    {
+        uint idx = base + k;
+        if (idx < count)
+        {
+            values[idx] += prefix;
+        }
+    }
+}
+
+void main()
+{
+    if (stage == 0)
+    {
+        scan_block();
+    }
+    else
+    {
+        add_block_offsets();
+    }
+}
@@ -0,0 +1,94 @@
+#version 430 core
+
+// Splat every body into a fixed point accumulation buffer (r, g, b, count per pixel)
+
+layout(local_size_x = 128) in;
+
+layout(std430, binding = 0) buffer Positions
+{
+    vec4 positions[];
+};
+
+layout(std430, binding = 2) buffer Colors
+{
+    vec4 colors[];
+};
+
+layout(std430, binding = 4) buffer Accumulation
+{
+    uint accumulation[];
+};
+
+layout(std430, binding = 5) buffer PreviousAccumulation
+{
+    uint previous_accumulation[];
+};
+
+uniform mat4 mvp;
+uniform uint count;
+uniform uvec2 resolution;
+uniform bool density_lod;
+uniform float lod_threshold;
+
+const float FIXED_POINT_SCALE = 256.0;
+
+// Same PCG hash as the scene generation
+float hash(uint seed)
+{
+    uint state = seed * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    word = (word >> 22u) ^ word;
+    return float(word) / 4294967295.0;
+}
+
+void main()
+{
+    uint gid = gl_GlobalInvocationID.x;
+    if (gid >= count)
+    {
+        return;
+    }
+
+    vec4 clip = mvp * vec4(positions[gid].xyz, 1.0);
+    if (clip.w <= 0.0)
+    {
+        return;
+    }
+
+    // Near / far planes as GL_POINTS would clip them, then the screen edges, which also keep the index in bounds
+    vec3 ndc = clip.xyz / clip.w;
+    if (ndc.z < -1.0 || ndc.z > 1.0)
+    {
+        return;
+    }
+
+    ivec2 pixel = ivec2(floor((ndc.xy * 0.5 + 0.5) * vec2(resolution)));
+    if (any(lessThan(pixel, ivec2(0))) || any(greaterThanEqual(pixel, ivec2(resolution))))
+    {
+        return;
+    }
+
+    uint index = 4 * (uint(pixel.y) * resolution.x + uint(pixel.x));
+
+    // Thin out saturated pixels: keep a stable random subset, weighted to preserve brightness
+    float weight = 1.0;
+    if (density_lod)
+    {
+        float density = float(previous_accumulation[index + 3]);
+        if (density > lod_threshold)
+        {
+            float keep = lod_threshold / density;
+            if (hash(gid) > keep)
+            {
+                return;
+            }
+            weight = 1.0 / keep;
+        }
+    }
+
+    vec3 color = colors[gid].rgb * weight * FIXED_POINT_SCALE;
+    atomicAdd(accumulation[index + 0], uint(color.r));
+    atomicAdd(accumulation[index + 1], uint(color.g));
+    atomicAdd(accumulation[index + 2], uint(color.b));
+    atomicAdd(accumulation[index + 3], uint(weight + 0.5));
+}
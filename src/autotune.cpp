@@ -0,0 +1,286 @@
+#include "autotune.hpp"
+#include "gl_resources.hpp"
+#include "gravity.hpp"
+#include "scene.hpp"
+#include "simulation_parameters.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Timed calls of a backend are repeated for at least this long
+static constexpr double MIN_TIMING_SECONDS = 0.05;
+
+static constexpr GLuint WORKGROUP_SIZE = 128;
+
+using Clock = std::chrono::steady_clock;
+
+std::string_view gravity_backend_to_string(GravityBackend backend)
+{
+    switch (backend)
+    {
+    case GravityBackend::Gpu:
+        return "gpu";
+    case GravityBackend::Cpu:
+        return "cpu";
+    case GravityBackend::Tree:
+        return "tree";
+    }
+    return "unknown";
+}
+
+std::optional<GravityBackend> gravity_backend_from_string(std::string_view name)
+{
+    for (GravityBackend backend : {GravityBackend::Gpu, GravityBackend::Cpu, GravityBackend::Tree})
+    {
+        if (name == gravity_backend_to_string(backend))
+        {
+            return backend;
+        }
+    }
+    return std::nullopt;
+}
+
+// Average seconds per call of f
+template <typename F>
+[[nodiscard]]
+static double time_per_call(F &&f)
+{
+    std::size_t calls = 0;
+    Clock::time_point start = Clock::now();
+    double seconds = 0.0;
+    do
+    {
+        f();
+        ++calls;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < MIN_TIMING_SECONDS);
+    return seconds / static_cast<double>(calls);
+}
+
+// Line through two (interactions, seconds) measurements, the overhead and the slope are kept positive
+[[nodiscard]]
+static CostModel fit_cost_model(double interactions_a, double seconds_a, double interactions_b, double seconds_b)
+{
+    CostModel model;
+    if (interactions_b > interactions_a && seconds_b > seconds_a)
+    {
+        model.per_interaction = (seconds_b - seconds_a) / (interactions_b - interactions_a);
+        model.overhead = std::max(seconds_b - model.per_interaction * interactions_b, 0.0);
+    }
+    else
+    {
+        model.per_interaction = seconds_b / std::max(interactions_b, 1.0);
+    }
+    return model;
+}
+
+// Every stride-th body, the subsets keep the shape of the scene
+[[nodiscard]]
+static std::vector<glm::vec4> subset(std::span<const glm::vec4> positions_and_masses, std::size_t count)
+{
+    std::size_t stride = std::max<std::size_t>(positions_and_masses.size() / count, 1);
+    std::vector<glm::vec4> bodies;
+    bodies.reserve(count);
+    for (std::size_t i = 0; i < positions_and_masses.size() && bodies.size() < count; i += stride)
+    {
+        bodies.push_back(positions_and_masses[i]);
+    }
+    return bodies;
+}
+
+// One compute.glsl step, waited for
+[[nodiscard]]
+static double time_gpu_step(std::span<const glm::vec4> bodies, GLuint compute_program, UniformRing &ring)
+{
+    GLuint count = static_cast<GLuint>(bodies.size());
+    GLsizeiptr size = static_cast<GLsizeiptr>(bodies.size() * sizeof(glm::vec4));
+    std::array<Buffer, 2> positions = {make_buffer(size, bodies.data(), 0), make_buffer(size, nullptr, 0)};
+    Buffer velocities = make_buffer(size, nullptr, 0);
+    Buffer colors = make_buffer(size, nullptr, 0);
+    std::array<GLuint, 4> bindings = {positions[0].get(), velocities.get(), colors.get(), positions[1].get()};
+    glClearNamedBufferData(velocities.get(), GL_RGBA32F, GL_RGBA, GL_FLOAT, nullptr);
+
+    SimulationParameters parameters;
+    parameters.count = count;
+    parameters.dt = Scene::DT;
+    parameters.gravity = Scene::GRAVITY;
+    parameters.softening = Scene::SOFTENING;
+    update_uniform_ring(ring, parameters);
+
+    glUseProgram(compute_program);
+    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, bindings.data());
+    glFinish();
+
+    return time_per_call([&]()
+    {
+        glDispatchCompute((count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glFinish();
+    });
+}
+
+// Readback and upload of the positions and velocities, paid by the CPU backends every batch of steps
+[[nodiscard]]
+static double time_transfer(std::size_t count)
+{
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    std::vector<glm::vec4> bodies(count, glm::vec4(0.0f));
+    Buffer buffer = make_buffer(size, bodies.data(), GL_DYNAMIC_STORAGE_BIT);
+    glFinish();
+
+    return 2.0 * time_per_call([&]()
+    {
+        glGetNamedBufferSubData(buffer.get(), 0, size, bodies.data());
+        glNamedBufferSubData(buffer.get(), 0, size, bodies.data());
+        glFinish();
+    });
+}
+
+BackendTuner calibrate_backends(std::span<const glm::vec4> positions_and_masses, GLuint compute_program, double force_error_target)
+{
+    BackendTuner tuner;
+    tuner.force_error_target = force_error_target;
+    std::size_t count = positions_and_masses.size();
+
+    // All-pairs backends, a quarter of the bodies then all of them up to CALIBRATION_COUNT
+    std::size_t large = std::min(count, BackendTuner::CALIBRATION_COUNT);
+    std::size_t small = std::max<std::size_t>(large / 4, 1);
+    std::vector<glm::vec4> small_bodies = subset(positions_and_masses, small);
+    std::vector<glm::vec4> large_bodies = subset(positions_and_masses, large);
+    auto pairs = [](const std::vector<glm::vec4> &bodies) { return static_cast<double>(bodies.size()) * static_cast<double>(bodies.size()); };
+
+    UniformRing ring = make_uniform_ring(sizeof(SimulationParameters), SIMULATION_PARAMETERS_BINDING);
+    tuner.models[static_cast<std::size_t>(GravityBackend::Gpu)] =
+        fit_cost_model(pairs(small_bodies), time_gpu_step(small_bodies, compute_program, ring),
+                       pairs(large_bodies), time_gpu_step(large_bodies, compute_program, ring));
+
+    auto time_cpu_step = [](std::vector<glm::vec4> bodies)
+    {
+        std::vector<glm::vec4> velocities(bodies.size(), glm::vec4(0.0f));
+        std::vector<glm::vec4> scratch;
+        return time_per_call([&]() { step_direct_parallel(bodies, velocities, Scene::DT, Scene::GRAVITY, Scene::SOFTENING, scratch); });
+    };
+    tuner.models[static_cast<std::size_t>(GravityBackend::Cpu)] =
+        fit_cost_model(pairs(small_bodies), time_cpu_step(small_bodies), pairs(large_bodies), time_cpu_step(large_bodies));
+
+    // The tree is timed against the interactions it actually summed
+    auto time_tree_step = [](std::vector<glm::vec4> bodies, double &interactions)
+    {
+        std::vector<glm::vec4> velocities(bodies.size(), glm::vec4(0.0f));
+        std::vector<glm::vec4> scratch;
+        Octree tree;
+        return time_per_call([&]()
+        {
+            interactions = static_cast<double>(step_tree(bodies, velocities, Scene::DT, Scene::GRAVITY, Scene::SOFTENING, 0.5f, tree, scratch));
+        });
+    };
+    std::size_t large_tree = std::min(count, BackendTuner::TREE_CALIBRATION_COUNT);
+    double small_interactions = 0.0;
+    double large_interactions = 0.0;
+    double small_seconds = time_tree_step(subset(positions_and_masses, std::max<std::size_t>(large_tree / 4, 1)), small_interactions);
+    double large_seconds = time_tree_step(subset(positions_and_masses, large_tree), large_interactions);
+    tuner.models[static_cast<std::size_t>(GravityBackend::Tree)] = fit_cost_model(small_interactions, small_seconds, large_interactions, large_seconds);
+
+    // Per batch of steps, estimate_backends divides it by the batch length
+    double per_body_transfer = time_transfer(count) / static_cast<double>(std::max<std::size_t>(count, 1));
+    tuner.models[static_cast<std::size_t>(GravityBackend::Cpu)].per_body = per_body_transfer;
+    tuner.models[static_cast<std::size_t>(GravityBackend::Tree)].per_body = per_body_transfer;
+
+    return tuner;
+}
+
+std::vector<BackendEstimate> estimate_backends(BackendTuner &tuner, std::span<const glm::vec4> positions_and_masses)
+{
+    std::size_t count = positions_and_masses.size();
+    std::vector<glm::vec4> targets = subset(positions_and_masses, std::min(count, BackendTuner::SAMPLE_SIZE));
+
+    // The targets offset is past every source index, the force of a body on itself is zero anyway
+    std::vector<glm::dvec3> reference(targets.size(), glm::dvec3(0.0));
+    accumulate_accelerations(targets, count, positions_and_masses, 0, Scene::GRAVITY, Scene::SOFTENING, reference);
+
+    // Theta 0 opens every node, the fp32 direct sum of the all-pairs backends
+    build_octree(tuner.tree, positions_and_masses);
+    auto measure = [&](float theta, double &interactions_per_body)
+    {
+        std::size_t interactions = 0;
+        double sum_sq = 0.0;
+        for (std::size_t i = 0; i < targets.size(); ++i)
+        {
+            glm::vec3 acceleration = octree_acceleration(tuner.tree, glm::vec3(targets[i]), theta, Scene::GRAVITY, Scene::SOFTENING, interactions);
+            double error = glm::length(glm::dvec3(acceleration) - reference[i]) / std::max(glm::length(reference[i]), 1e-30);
+            sum_sq += error * error;
+        }
+        interactions_per_body = static_cast<double>(interactions) / static_cast<double>(targets.size());
+        return std::sqrt(sum_sq / static_cast<double>(targets.size()));
+    };
+
+    double bodies = static_cast<double>(count);
+    double pairs = bodies * static_cast<double>(count > 0 ? count - 1 : 0);
+    double interactions_per_body = 0.0;
+    double direct_error = measure(0.0f, interactions_per_body);
+
+    std::vector<BackendEstimate> estimates;
+    for (GravityBackend backend : {GravityBackend::Gpu, GravityBackend::Cpu})
+    {
+        const CostModel &model = tuner.models[static_cast<std::size_t>(backend)];
+        estimates.push_back({backend, 0.0f, direct_error, pairs, model.seconds(bodies, pairs, tuner.steps_per_batch)});
+    }
+
+    // Largest opening angle within the target, the smallest one if none is
+    BackendEstimate tree{GravityBackend::Tree};
+    for (float theta : BackendTuner::THETAS)
+    {
+        double error = measure(theta, interactions_per_body);
+        if (theta != BackendTuner::THETAS.front() && error > tuner.force_error_target)
+        {
+            break;
+        }
+        tree.theta = theta;
+        tree.force_error = error;
+        tree.interactions = interactions_per_body * bodies;
+    }
+    tree.seconds = tuner.models[static_cast<std::size_t>(GravityBackend::Tree)].seconds(bodies, tree.interactions, tuner.steps_per_batch);
+    estimates.push_back(tree);
+
+    return estimates;
+}
+
+bool select_backend(BackendTuner &tuner, const std::vector<BackendEstimate> &estimates)
+{
+    const BackendEstimate *best = nullptr;
+    const BackendEstimate *current = nullptr;
+    for (const BackendEstimate &estimate : estimates)
+    {
+        if (estimate.force_error > tuner.force_error_target)
+        {
+            continue;
+        }
+        if (!best || estimate.seconds < best->seconds)
+        {
+            best = &estimate;
+        }
+        if (estimate.backend == tuner.backend)
+        {
+            current = &estimate;
+        }
+    }
+
+    if (!best)
+    {
+        best = &*std::min_element(estimates.begin(), estimates.end(),
+                                  [](const BackendEstimate &a, const BackendEstimate &b) { return a.force_error < b.force_error; });
+    }
+    else if (current && best->seconds > (1.0 - BackendTuner::SWITCH_GAIN) * current->seconds)
+    {
+        // Not worth a switch
+        best = current;
+    }
+
+    bool changed = best->backend != tuner.backend || (best->backend == GravityBackend::Tree && best->theta != tuner.theta);
+    tuner.backend = best->backend;
+    if (best->backend == GravityBackend::Tree)
+    {
+        tuner.theta = best->theta;
+    }
+    return changed;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "tree.hpp"
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+// Gravity solvers of the simulation
+enum class GravityBackend
+{
+    Gpu,  // compute.glsl all-pairs sum, in the current step mode
+    Cpu,  // all-pairs sum on the worker threads, the bodies go through the CPU every batch of steps
+    Tree, // Barnes-Hut octree on the worker threads, see tree.hpp
+};
+
+static constexpr std::size_t GRAVITY_BACKEND_COUNT = 3;
+
+[[nodiscard]]
+std::string_view gravity_backend_to_string(GravityBackend backend);
+
+[[nodiscard]]
+std::optional<GravityBackend> gravity_backend_from_string(std::string_view name);
+
+// Seconds per step = overhead + per_body * bodies / steps_per_batch + per_interaction * interactions
+struct CostModel
+{
+    double overhead = 0.0;
+    double per_body = 0.0; // transfers of the CPU backends, paid once per batch of steps
+    double per_interaction = 0.0;
+
+    [[nodiscard]]
+    double seconds(double bodies, double interactions, double steps_per_batch) const
+    {
+        return overhead + per_body * bodies / steps_per_batch + per_interaction * interactions;
+    }
+};
+
+// Predicted cost and force error of one backend on the current bodies
+struct BackendEstimate
+{
+    GravityBackend backend = GravityBackend::Gpu;
+    float theta = 0.0f;        // opening angle, tree only
+    double force_error = 0.0;  // rms relative error against a double precision direct sum
+    double interactions = 0.0; // per step
+    double seconds = 0.0;      // per step
+};
+
+// Picks the fastest backend within a force error target. The cost models are fitted once on the
+// hardware; the interactions and the force error of each backend are measured again on the bodies
+// at every estimate, as clustering makes the tree walk longer and changes the opening angle it needs.
+struct BackendTuner
+{
+    static constexpr std::size_t SAMPLE_SIZE = 256;             // bodies the force error is measured on
+    static constexpr std::size_t CALIBRATION_COUNT = 4096;      // largest subset timed for the all-pairs backends
+    static constexpr std::size_t TREE_CALIBRATION_COUNT = 32768;
+    static constexpr std::array<float, 8> THETAS = {0.1f, 0.15f, 0.2f, 0.3f, 0.4f, 0.5f, 0.7f, 1.0f};
+    static constexpr double SWITCH_GAIN = 0.1; // a backend replaces the current one when predicted this much faster
+
+    double force_error_target = 5e-3;
+    double steps_per_batch = 1.0; // expected steps between two transfers of the CPU backends
+    std::array<CostModel, GRAVITY_BACKEND_COUNT> models{};
+    GravityBackend backend = GravityBackend::Gpu;
+    float theta = 0.5f;
+    Octree tree;
+};
+
+// Fit the cost models by timing every backend on two subsets of the bodies. Needs a current OpenGL
+// context, compute_program is compute.glsl. The SimulationParameters block binding is overwritten.
+[[nodiscard]]
+BackendTuner calibrate_backends(std::span<const glm::vec4> positions_and_masses, GLuint compute_program, double force_error_target);
+
+// Estimate of every backend on the bodies, the tree at the largest opening angle within the target.
+// Set steps_per_batch first, the transfers of the CPU backends are spread over the batch.
+[[nodiscard]]
+std::vector<BackendEstimate> estimate_backends(BackendTuner &tuner, std::span<const glm::vec4> positions_and_masses);
+
+// Move to the fastest backend within the target, or the most accurate one if none is.
+// Returns true if the backend or its opening angle changed.
+bool select_backend(BackendTuner &tuner, const std::vector<BackendEstimate> &estimates);
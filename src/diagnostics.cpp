@@ -0,0 +1,179 @@
+#include "diagnostics.hpp"
+#include "parallel.hpp"
+#include "shader.hpp"
+#include <filesystem>
+#include <vector>
+
+static const std::filesystem::path DIAGNOSTICS_SHADER_FILEPATH = "../shaders/diagnostics.glsl";
+
+// vec4 per quantity, see diagnostics.glsl
+static constexpr std::size_t RESULT_VEC4S = 4;
+
+[[nodiscard]]
+static GLuint num_groups(GLuint count)
+{
+    return (count + DiagnosticsPass::WORKGROUP_SIZE - 1) / DiagnosticsPass::WORKGROUP_SIZE;
+}
+
+DiagnosticsPass make_diagnostics_pass(std::size_t capacity)
+{
+    DiagnosticsPass pass;
+
+    GLsizeiptr results_size = RESULT_VEC4S * sizeof(glm::vec4);
+    pass.program.reset(make_compute_shader_program(DIAGNOSTICS_SHADER_FILEPATH));
+    pass.partials = make_buffer(num_groups(static_cast<GLuint>(capacity)) * results_size, nullptr, 0);
+    pass.results = make_buffer(results_size, nullptr, 0);
+
+    // Read back by the CPU, kept in client memory
+    for (Buffer &buffer : pass.readback_buffers)
+    {
+        buffer = make_buffer(results_size, nullptr, GL_CLIENT_STORAGE_BIT);
+    }
+
+    return pass;
+}
+
+void reload_diagnostics_program(DiagnosticsPass &pass)
+{
+    pass.program.reset(reload_compute_shader_program(pass.program.release(), DIAGNOSTICS_SHADER_FILEPATH));
+}
+
+void dispatch_diagnostics(DiagnosticsPass &pass, GLuint positions, GLuint velocities, GLuint count, float gravity, float softening, std::size_t step,
+                          GLuint energies)
+{
+    // Every slot still in flight, drop this sample rather than stall
+    if (!pass.program || pass.submitted - pass.completed == DiagnosticsPass::RING_SIZE)
+    {
+        return;
+    }
+
+    GLuint groups = num_groups(count);
+    GLuint program = pass.program.get();
+
+    glUseProgram(program);
+    glUniform1ui(glGetUniformLocation(program, "count"), count);
+    glUniform1ui(glGetUniformLocation(program, "num_partials"), groups);
+    glUniform1f(glGetUniformLocation(program, "gravity"), gravity);
+    glUniform1f(glGetUniformLocation(program, "softening"), softening);
+    glUniform1ui(glGetUniformLocation(program, "force_pass_energies"), energies != 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, pass.partials.get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, pass.results.get());
+    if (energies != 0)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, energies);
+    }
+
+    glUniform1ui(glGetUniformLocation(program, "stage"), 0);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUniform1ui(glGetUniformLocation(program, "stage"), 1);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Copy into the ring, the fence tells when it can be read without waiting
+    std::size_t slot = pass.submitted % DiagnosticsPass::RING_SIZE;
+    glCopyNamedBufferSubData(pass.results.get(), pass.readback_buffers[slot].get(), 0, 0, RESULT_VEC4S * sizeof(glm::vec4));
+
+    pass.fences[slot] = make_fence();
+    pass.steps[slot] = step;
+    ++pass.submitted;
+}
+
+[[nodiscard]]
+static Diagnostics unpack_diagnostics(const glm::vec4 (&results)[RESULT_VEC4S])
+{
+    Diagnostics diagnostics;
+    diagnostics.kinetic_energy = results[0].x;
+    diagnostics.potential_energy = results[0].y;
+    diagnostics.total_mass = results[0].z;
+    diagnostics.momentum = glm::vec3(results[1]);
+    diagnostics.angular_momentum = glm::vec3(results[2]);
+    diagnostics.center_of_mass = diagnostics.total_mass > 0.0f ? glm::vec3(results[3]) / diagnostics.total_mass : glm::vec3(0.0f);
+    return diagnostics;
+}
+
+std::optional<std::pair<std::size_t, Diagnostics>> poll_diagnostics(DiagnosticsPass &pass)
+{
+    if (pass.completed == pass.submitted)
+    {
+        return std::nullopt;
+    }
+
+    std::size_t slot = pass.completed % DiagnosticsPass::RING_SIZE;
+    GLenum status = glClientWaitSync(pass.fences[slot].get(), GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+        return std::nullopt;
+    }
+
+    pass.fences[slot].reset();
+
+    glm::vec4 results[RESULT_VEC4S];
+    glGetNamedBufferSubData(pass.readback_buffers[slot].get(), 0, sizeof(results), results);
+
+    ++pass.completed;
+    return std::pair{pass.steps[slot], unpack_diagnostics(results)};
+}
+
+Diagnostics compute_diagnostics(std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities, float gravity, float softening)
+{
+    double eps_sq = static_cast<double>(softening) * softening;
+
+    // Potential of each body, the O(N^2) part
+    std::vector<double> potentials(positions_and_masses.size(), 0.0);
+    parallel_for(positions_and_masses.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            glm::dvec3 position(positions_and_masses[i]);
+            double potential = 0.0;
+
+            for (std::size_t j = 0; j < positions_and_masses.size(); ++j)
+            {
+                if (i == j)
+                {
+                    continue;
+                }
+
+                glm::dvec3 dpos = glm::dvec3(positions_and_masses[j]) - position;
+                potential += positions_and_masses[j].w / std::sqrt(glm::dot(dpos, dpos) + eps_sq);
+            }
+
+            potentials[i] = potential;
+        }
+    });
+
+    double kinetic_energy = 0.0;
+    double potential_energy = 0.0;
+    double total_mass = 0.0;
+    glm::dvec3 momentum(0.0);
+    glm::dvec3 angular_momentum(0.0);
+    glm::dvec3 weighted_position(0.0);
+
+    for (std::size_t i = 0; i < positions_and_masses.size(); ++i)
+    {
+        glm::dvec3 position(positions_and_masses[i]);
+        glm::dvec3 velocity(velocities[i]);
+        double mass = positions_and_masses[i].w;
+
+        kinetic_energy += 0.5 * mass * glm::dot(velocity, velocity);
+        // Each pair is seen twice, hence the 0.5
+        potential_energy -= 0.5 * gravity * mass * potentials[i];
+        total_mass += mass;
+        momentum += mass * velocity;
+        angular_momentum += mass * glm::cross(position, velocity);
+        weighted_position += mass * position;
+    }
+
+    Diagnostics diagnostics;
+    diagnostics.kinetic_energy = static_cast<float>(kinetic_energy);
+    diagnostics.potential_energy = static_cast<float>(potential_energy);
+    diagnostics.total_mass = static_cast<float>(total_mass);
+    diagnostics.momentum = glm::vec3(momentum);
+    diagnostics.angular_momentum = glm::vec3(angular_momentum);
+    diagnostics.center_of_mass = total_mass > 0.0 ? glm::vec3(weighted_position / total_mass) : glm::vec3(0.0f);
+    return diagnostics;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include <array>
+#include <cmath>
+#include <optional>
+#include <span>
+#include <utility>
+#include <glm/glm.hpp>
+
+// Conservation diagnostics of the whole system
+struct Diagnostics
+{
+    float kinetic_energy = 0.0f;
+    float potential_energy = 0.0f;
+    float total_mass = 0.0f;
+    glm::vec3 momentum{0.0f};
+    glm::vec3 angular_momentum{0.0f};
+    glm::vec3 center_of_mass{0.0f};
+
+    [[nodiscard]]
+    float total_energy() const
+    {
+        return kinetic_energy + potential_energy;
+    }
+
+    // 2K / |W|, 1 at virial equilibrium
+    [[nodiscard]]
+    float virial_ratio() const
+    {
+        return potential_energy != 0.0f ? 2.0f * kinetic_energy / std::abs(potential_energy) : 0.0f;
+    }
+};
+
+// GPU reduction pass, results come back asynchronously through a small ring of buffers
+struct DiagnosticsPass
+{
+    static constexpr GLuint WORKGROUP_SIZE = 128;
+    static constexpr std::size_t RING_SIZE = 4;
+
+    Program program;
+    Buffer partials;
+    Buffer results;
+
+    std::array<Buffer, RING_SIZE> readback_buffers;
+    std::array<Fence, RING_SIZE> fences;
+    std::array<std::size_t, RING_SIZE> steps{};
+    std::size_t submitted = 0;
+    std::size_t completed = 0;
+};
+
+[[nodiscard]]
+DiagnosticsPass make_diagnostics_pass(std::size_t capacity);
+
+void reload_diagnostics_program(DiagnosticsPass &pass);
+
+// Queue the reduction for the current state, tagged with its step. Skipped if the ring is full.
+// energies, if not 0, are those compute_potential.glsl wrote in the last step: kinetic and potential
+// energy are summed from them instead of a pair loop, and are those of the positions that step started from.
+void dispatch_diagnostics(DiagnosticsPass &pass, GLuint positions, GLuint velocities, GLuint count, float gravity, float softening, std::size_t step,
+                          GLuint energies = 0);
+
+// Oldest finished result with its step, never waits for the GPU
+[[nodiscard]]
+std::optional<std::pair<std::size_t, Diagnostics>> poll_diagnostics(DiagnosticsPass &pass);
+
+// CPU equivalent, accumulated in double precision
+[[nodiscard]]
+Diagnostics compute_diagnostics(std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities, float gravity, float softening);
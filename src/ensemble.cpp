@@ -0,0 +1,150 @@
+#include "ensemble.hpp"
+#include "gl_resources.hpp"
+#include "gravity.hpp"
+#include "parallel.hpp"
+#include "scene.hpp"
+#include "shader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <utility>
+
+static const std::filesystem::path ENSEMBLE_SHADER_FILEPATH = "../shaders/ensemble.glsl";
+static constexpr GLuint WORKGROUP_SIZE = 128;
+
+// Matches the std430 Simulation struct in ensemble.glsl
+struct GpuSimulation
+{
+    GLuint offset;
+    GLuint count;
+    float gravity;
+    float softening;
+};
+static_assert(sizeof(GpuSimulation) == 16);
+
+using Clock = std::chrono::steady_clock;
+
+Ensemble make_ensemble(std::size_t members, std::size_t count, uint32_t seed, glm::vec2 gravity_range, glm::vec2 softening_range)
+{
+    Ensemble ensemble;
+    ensemble.count = count;
+    ensemble.members.resize(members);
+    ensemble.positions_and_masses.resize(members * count);
+    ensemble.velocities.resize(members * count);
+
+    parallel_for(members, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t e = begin; e < end; ++e)
+        {
+            float t = members > 1 ? static_cast<float>(e) / static_cast<float>(members - 1) : 0.0f;
+
+            EnsembleMember &member = ensemble.members[e];
+            member.seed = seed + static_cast<uint32_t>(e);
+            member.gravity = glm::mix(gravity_range.x, gravity_range.y, t);
+            member.softening = glm::mix(softening_range.x, softening_range.y, t);
+
+            Scene scene = create_sun_collapse(member.seed, count);
+            std::copy(scene.positions_and_masses.begin(), scene.positions_and_masses.end(), ensemble.positions_and_masses.begin() + e * count);
+            std::copy(scene.velocities.begin(), scene.velocities.end(), ensemble.velocities.begin() + e * count);
+        }
+    });
+
+    return ensemble;
+}
+
+EnsembleStats run_ensemble_cpu(Ensemble &ensemble, std::size_t steps, float dt)
+{
+    EnsembleStats stats{ensemble.members.size(), ensemble.count, steps, 0.0};
+    Clock::time_point start = Clock::now();
+
+    parallel_for(ensemble.members.size(), [&](std::size_t begin, std::size_t end)
+    {
+        std::vector<glm::vec4> scratch;
+        for (std::size_t e = begin; e < end; ++e)
+        {
+            const EnsembleMember &member = ensemble.members[e];
+            std::span positions(ensemble.positions_and_masses.data() + e * ensemble.count, ensemble.count);
+            std::span velocities(ensemble.velocities.data() + e * ensemble.count, ensemble.count);
+
+            for (std::size_t step = 0; step < steps; ++step)
+            {
+                step_direct(positions, velocities, dt, member.gravity, member.softening, scratch);
+            }
+        }
+    });
+
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return stats;
+}
+
+[[nodiscard]]
+static Buffer make_storage_buffer(GLsizeiptr size, const void *data, GLuint binding)
+{
+    Buffer buffer = make_buffer(size, data, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.get());
+    return buffer;
+}
+
+EnsembleStats run_ensemble_gpu(Ensemble &ensemble, std::size_t steps, float dt)
+{
+    EnsembleStats stats{ensemble.members.size(), ensemble.count, steps, 0.0};
+
+    Program program{make_compute_shader_program(ENSEMBLE_SHADER_FILEPATH)};
+    if (!program)
+    {
+        return stats;
+    }
+
+    std::vector<GpuSimulation> simulations;
+    simulations.reserve(ensemble.members.size());
+    for (std::size_t e = 0; e < ensemble.members.size(); ++e)
+    {
+        const EnsembleMember &member = ensemble.members[e];
+        simulations.push_back({static_cast<GLuint>(e * ensemble.count), static_cast<GLuint>(ensemble.count), member.gravity, member.softening});
+    }
+
+    GLsizeiptr bodies_size = ensemble.positions_and_masses.size() * sizeof(glm::vec4);
+    Buffer positions_and_masses_in = make_storage_buffer(bodies_size, ensemble.positions_and_masses.data(), 0);
+    Buffer velocities_buffer = make_storage_buffer(bodies_size, ensemble.velocities.data(), 1);
+    Buffer positions_and_masses_out = make_storage_buffer(bodies_size, nullptr, 3);
+    Buffer simulations_buffer = make_storage_buffer(static_cast<GLsizeiptr>(simulations.size() * sizeof(GpuSimulation)), simulations.data(), 4);
+
+    glUseProgram(program.get());
+    glUniform1f(glGetUniformLocation(program.get(), "dt"), dt);
+
+    GLuint num_groups_x = static_cast<GLuint>((ensemble.count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+    GLuint num_groups_y = static_cast<GLuint>(ensemble.members.size());
+
+    glFinish();
+    Clock::time_point start = Clock::now();
+
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_and_masses_in.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, positions_and_masses_out.get());
+        glDispatchCompute(num_groups_x, num_groups_y, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        std::swap(positions_and_masses_in, positions_and_masses_out);
+    }
+
+    glFinish();
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Final state
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetNamedBufferSubData(positions_and_masses_in.get(), 0, bodies_size, ensemble.positions_and_masses.data());
+    glGetNamedBufferSubData(velocities_buffer.get(), 0, bodies_size, ensemble.velocities.data());
+
+    return stats;
+}
+
+double simulations_per_hour(const EnsembleStats &stats)
+{
+    if (stats.seconds <= 0.0)
+    {
+        return 0.0;
+    }
+    return static_cast<double>(stats.simulations) * 3600.0 / stats.seconds;
+}
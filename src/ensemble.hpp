@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Parameters of one simulation in an ensemble
+struct EnsembleMember
+{
+    uint32_t seed = 0;
+    float gravity = 0.0f;
+    float softening = 0.0f;
+};
+
+// Independent simulations of count bodies each, packed back to back: simulation e starts at e * count
+struct Ensemble
+{
+    std::size_t count = 0;
+    std::vector<EnsembleMember> members;
+    std::vector<glm::vec4> positions_and_masses;
+    std::vector<glm::vec4> velocities;
+};
+
+struct EnsembleStats
+{
+    std::size_t simulations = 0;
+    std::size_t count = 0;
+    std::size_t steps = 0;
+    double seconds = 0.0;
+};
+
+// Parameter sweep: member e uses seed + e, gravity and softening are spread linearly over [min, max]
+[[nodiscard]]
+Ensemble make_ensemble(std::size_t members, std::size_t count, uint32_t seed, glm::vec2 gravity_range, glm::vec2 softening_range);
+
+// Advance every simulation on the CPU, one simulation per thread at a time
+[[nodiscard]]
+EnsembleStats run_ensemble_cpu(Ensemble &ensemble, std::size_t steps, float dt);
+
+// Advance every simulation with one dispatch per step, needs a current OpenGL context.
+// The final state is read back into the ensemble.
+[[nodiscard]]
+EnsembleStats run_ensemble_gpu(Ensemble &ensemble, std::size_t steps, float dt);
+
+[[nodiscard]]
+double simulations_per_hour(const EnsembleStats &stats);
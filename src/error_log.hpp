@@ -11,6 +11,15 @@ enum class ErrorType
     ShaderModuleCompilation,
     ShaderProgramLinking,
     GLADInitialization,
+    CommandLineParsing,
+    FrameExport,
+    FileMapping,
+    HaloFinder,
+    Trajectory,
+    ResourceCreation,
+    SceneDescription,
+    Validation,
+    Synchronization,
 };
 
 inline void log_error(ErrorType type, std::string_view what)
@@ -29,6 +38,33 @@ inline void log_error(ErrorType type, std::string_view what)
             break;
         case ErrorType::GLADInitialization:
             error = "[GLAD INITIALIZATION ERROR]\n";
+            break;
+        case ErrorType::CommandLineParsing:
+            error = "[COMMAND LINE PARSING ERROR]\n";
+            break;
+        case ErrorType::FrameExport:
+            error = "[FRAME EXPORT ERROR]\n";
+            break;
+        case ErrorType::FileMapping:
+            error = "[FILE MAPPING ERROR]\n";
+            break;
+        case ErrorType::HaloFinder:
+            error = "[HALO FINDER ERROR]\n";
+            break;
+        case ErrorType::Trajectory:
+            error = "[TRAJECTORY ERROR]\n";
+            break;
+        case ErrorType::ResourceCreation:
+            error = "[RESOURCE CREATION ERROR]\n";
+            break;
+        case ErrorType::SceneDescription:
+            error = "[SCENE DESCRIPTION ERROR]\n";
+            break;
+        case ErrorType::Validation:
+            error = "[VALIDATION ERROR]\n";
+            break;
+        case ErrorType::Synchronization:
+            error = "[SYNCHRONIZATION ERROR]\n";
     }
     
     std::cerr << std::format("{}{}\n", error, what);
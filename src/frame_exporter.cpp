@@ -0,0 +1,178 @@
+#include "frame_exporter.hpp"
+#include "error_log.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <format>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+static constexpr GLuint64 FENCE_TIMEOUT_NS = 1'000'000'000;
+
+[[nodiscard]]
+static std::size_t frame_size(const FrameExporter &exporter)
+{
+    return static_cast<std::size_t>(exporter.width) * exporter.height * 3;
+}
+
+FrameExporter make_frame_exporter(const std::filesystem::path &path, int width, int height)
+{
+    FrameExporter exporter;
+    exporter.width = width;
+    exporter.height = height;
+
+#ifndef _WIN32
+    // A reader that exits early, e.g. ffmpeg, has to fail the write instead of killing the process
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if (path == "-")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        exporter.output = stdout;
+    }
+    else
+    {
+        exporter.output = std::fopen(path.string().c_str(), "wb");
+        exporter.owns_output = true;
+        if (!exporter.output)
+        {
+            log_error(ErrorType::FrameExport, std::format("Cannot open '{}'", path.string()));
+            return exporter;
+        }
+    }
+
+    // Framebuffer at the export resolution, independent of the window
+    exporter.color_renderbuffer = make_renderbuffer(GL_RGBA8, width, height);
+    exporter.depth_renderbuffer = make_renderbuffer(GL_DEPTH_COMPONENT24, width, height);
+    exporter.framebuffer = make_framebuffer();
+    glNamedFramebufferRenderbuffer(exporter.framebuffer.get(), GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, exporter.color_renderbuffer.get());
+    glNamedFramebufferRenderbuffer(exporter.framebuffer.get(), GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, exporter.depth_renderbuffer.get());
+
+    if (glCheckNamedFramebufferStatus(exporter.framebuffer.get(), GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        log_error(ErrorType::FrameExport, std::format("Incomplete framebuffer at {}x{}", width, height));
+        finish_frame_export(exporter);
+        return exporter;
+    }
+
+    // Readback ring, mapped for reading by the CPU
+    for (Buffer &buffer : exporter.pixel_buffers)
+    {
+        buffer = make_buffer(static_cast<GLsizeiptr>(frame_size(exporter)), nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+    }
+
+    return exporter;
+}
+
+void begin_export_frame(const FrameExporter &exporter)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, exporter.framebuffer.get());
+    glViewport(0, 0, exporter.width, exporter.height);
+}
+
+// Wait for the fence of a slot and stream its pixels, flipping rows to top-down order
+static void write_slot(FrameExporter &exporter, std::size_t slot)
+{
+    Fence &fence = exporter.fences[slot];
+    GLenum status = glClientWaitSync(fence.get(), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+    while (status == GL_TIMEOUT_EXPIRED)
+    {
+        status = glClientWaitSync(fence.get(), 0, FENCE_TIMEOUT_NS);
+    }
+    if (status == GL_WAIT_FAILED)
+    {
+        log_error(ErrorType::Synchronization, "Waiting for an exported frame failed, finishing the queue instead");
+        glFinish();
+    }
+    fence.reset();
+
+    if (exporter.failed)
+    {
+        return;
+    }
+
+    GLuint buffer = exporter.pixel_buffers[slot].get();
+    const auto *pixels = static_cast<const std::uint8_t *>(glMapNamedBufferRange(buffer, 0, static_cast<GLsizeiptr>(frame_size(exporter)), GL_MAP_READ_BIT));
+    if (!pixels)
+    {
+        log_error(ErrorType::FrameExport, std::format("Cannot map the pixels of frame {}", exporter.frames_written));
+        exporter.failed = true;
+        return;
+    }
+
+    std::size_t row_size = static_cast<std::size_t>(exporter.width) * 3;
+    for (int y = exporter.height - 1; y >= 0 && !exporter.failed; --y)
+    {
+        if (std::fwrite(pixels + y * row_size, 1, row_size, exporter.output) != row_size || std::ferror(exporter.output))
+        {
+            log_error(ErrorType::FrameExport, std::format("Writing frame {} failed: {}", exporter.frames_written, std::strerror(errno)));
+            exporter.failed = true;
+        }
+    }
+    glUnmapNamedBuffer(buffer);
+
+    if (!exporter.failed)
+    {
+        ++exporter.frames_written;
+    }
+}
+
+void end_export_frame(FrameExporter &exporter)
+{
+    if (exporter.failed)
+    {
+        return;
+    }
+
+    std::size_t slot = exporter.frames_submitted % FrameExporter::RING_SIZE;
+
+    // Ring is full: the frame submitted RING_SIZE frames ago is done by now in most cases
+    if (exporter.fences[slot])
+    {
+        write_slot(exporter, slot);
+    }
+
+    // Asynchronous readback into the pixel buffer, returns immediately
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, exporter.framebuffer.get());
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, exporter.pixel_buffers[slot].get());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, exporter.width, exporter.height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    exporter.fences[slot] = make_fence();
+    ++exporter.frames_submitted;
+}
+
+void finish_frame_export(FrameExporter &exporter)
+{
+    // Drain pending frames in submission order
+    for (std::size_t i = 0; i < FrameExporter::RING_SIZE; ++i)
+    {
+        std::size_t slot = (exporter.frames_submitted + i) % FrameExporter::RING_SIZE;
+        if (exporter.fences[slot])
+        {
+            write_slot(exporter, slot);
+        }
+    }
+
+    if (exporter.output)
+    {
+        bool flushed = std::fflush(exporter.output) == 0 && !std::ferror(exporter.output);
+        bool closed = !exporter.owns_output || std::fclose(exporter.output) == 0;
+        if ((!flushed || !closed) && !exporter.failed)
+        {
+            log_error(ErrorType::FrameExport, std::format("Writing the exported frames failed: {}", std::strerror(errno)));
+            exporter.failed = true;
+        }
+    }
+
+    exporter.output = nullptr;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include <array>
+#include <cstdio>
+#include <filesystem>
+
+// Offscreen rendering to a framebuffer, read back through a ring of pixel buffers.
+// Frames are streamed as raw top-down RGB24 so they can be piped into an encoder, e.g.
+// ffmpeg -f rawvideo -pix_fmt rgb24 -s 3840x2160 -r 60 -i - universe.mp4
+struct FrameExporter
+{
+    static constexpr std::size_t RING_SIZE = 3;
+
+    Framebuffer framebuffer;
+    Renderbuffer color_renderbuffer;
+    Renderbuffer depth_renderbuffer;
+
+    std::array<Buffer, RING_SIZE> pixel_buffers;
+    std::array<Fence, RING_SIZE> fences;
+
+    int width = 0;
+    int height = 0;
+    std::size_t frames_submitted = 0;
+    std::size_t frames_written = 0;
+
+    std::FILE *output = nullptr;
+    bool owns_output = false;
+    bool failed = false; // a write failed, the remaining frames are dropped
+};
+
+// Create the framebuffer and pixel buffers, output is nullptr on failure
+[[nodiscard]]
+FrameExporter make_frame_exporter(const std::filesystem::path &path, int width, int height);
+
+// Bind the offscreen framebuffer, following draws go to the next exported frame
+void begin_export_frame(const FrameExporter &exporter);
+
+// Queue the readback of the current frame, writes the oldest pending frame once the ring is full.
+// Does nothing once a write has failed.
+void end_export_frame(FrameExporter &exporter);
+
+// Write all pending frames and close the output, failed is set if anything could not be written
+void finish_frame_export(FrameExporter &exporter);
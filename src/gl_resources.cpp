@@ -0,0 +1,97 @@
+#include "gl_resources.hpp"
+#include "error_log.hpp"
+#include <cstring>
+
+static constexpr GLbitfield PERSISTENT_WRITE_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+static constexpr GLuint64 FENCE_TIMEOUT_NS = 1'000'000'000;
+
+Buffer make_buffer(GLsizeiptr size, const void *data, GLbitfield flags)
+{
+    GLuint buffer = 0;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, size, data, flags);
+    return Buffer{buffer};
+}
+
+VertexArray make_vertex_array()
+{
+    GLuint vao = 0;
+    glCreateVertexArrays(1, &vao);
+    return VertexArray{vao};
+}
+
+Framebuffer make_framebuffer()
+{
+    GLuint framebuffer = 0;
+    glCreateFramebuffers(1, &framebuffer);
+    return Framebuffer{framebuffer};
+}
+
+Renderbuffer make_renderbuffer(GLenum format, GLsizei width, GLsizei height)
+{
+    GLuint renderbuffer = 0;
+    glCreateRenderbuffers(1, &renderbuffer);
+    glNamedRenderbufferStorage(renderbuffer, format, width, height);
+    return Renderbuffer{renderbuffer};
+}
+
+Query make_query(GLenum target)
+{
+    GLuint query = 0;
+    glCreateQueries(target, 1, &query);
+    return Query{query};
+}
+
+Fence make_fence()
+{
+    return Fence{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)};
+}
+
+UniformRing make_uniform_ring(GLsizeiptr block_size, GLuint binding)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    UniformRing ring;
+    ring.block_size = block_size;
+    ring.slot_size = (block_size + alignment - 1) / alignment * alignment;
+    ring.binding = binding;
+
+    GLsizeiptr size = ring.slot_size * static_cast<GLsizeiptr>(UniformRing::RING_SIZE);
+    ring.buffer = make_buffer(size, nullptr, PERSISTENT_WRITE_FLAGS);
+    ring.mapped = static_cast<std::byte *>(glMapNamedBufferRange(ring.buffer.get(), 0, size, PERSISTENT_WRITE_FLAGS));
+
+    return ring;
+}
+
+void update_uniform_ring(UniformRing &ring, const void *block)
+{
+    // Everything submitted so far may read the current slot
+    if (ring.written)
+    {
+        ring.fences[ring.slot] = make_fence();
+        ring.slot = (ring.slot + 1) % UniformRing::RING_SIZE;
+    }
+
+    // The slot may only be overwritten once the fence is signalled, however long that takes
+    Fence &fence = ring.fences[ring.slot];
+    if (fence)
+    {
+        GLenum status = glClientWaitSync(fence.get(), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        while (status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(fence.get(), 0, FENCE_TIMEOUT_NS);
+        }
+        if (status == GL_WAIT_FAILED)
+        {
+            log_error(ErrorType::Synchronization, "Waiting for a uniform ring slot failed, finishing the queue instead");
+            glFinish();
+        }
+        fence.reset();
+    }
+
+    GLintptr offset = ring.slot_size * static_cast<GLintptr>(ring.slot);
+    std::memcpy(ring.mapped + offset, block, ring.block_size);
+    glBindBufferRange(GL_UNIFORM_BUFFER, ring.binding, ring.buffer.get(), offset, ring.block_size);
+    ring.written = true;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <glad/gl.h>
+
+// Owning OpenGL handle, released when it goes out of scope.
+// The context has to be current at that point: keep these in a scope that ends before the window is destroyed.
+template <typename Traits>
+class GLObject
+{
+public:
+    using Handle = typename Traits::Handle;
+
+    GLObject() = default;
+
+    explicit GLObject(Handle handle)
+        : handle_(handle)
+    {
+    }
+
+    ~GLObject()
+    {
+        reset();
+    }
+
+    GLObject(const GLObject &) = delete;
+    GLObject &operator=(const GLObject &) = delete;
+
+    GLObject(GLObject &&other) noexcept
+        : handle_(std::exchange(other.handle_, Handle{}))
+    {
+    }
+
+    GLObject &operator=(GLObject &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset(std::exchange(other.handle_, Handle{}));
+        }
+        return *this;
+    }
+
+    [[nodiscard]]
+    Handle get() const
+    {
+        return handle_;
+    }
+
+    explicit operator bool() const
+    {
+        return handle_ != Handle{};
+    }
+
+    // Give up ownership without releasing the object
+    [[nodiscard]]
+    Handle release()
+    {
+        return std::exchange(handle_, Handle{});
+    }
+
+    void reset(Handle handle = Handle{})
+    {
+        if (handle_ != Handle{})
+        {
+            Traits::destroy(handle_);
+        }
+        handle_ = handle;
+    }
+
+private:
+    Handle handle_{};
+};
+
+struct BufferTraits
+{
+    using Handle = GLuint;
+    static void destroy(GLuint buffer) { glDeleteBuffers(1, &buffer); }
+};
+
+struct ProgramTraits
+{
+    using Handle = GLuint;
+    static void destroy(GLuint program) { glDeleteProgram(program); }
+};
+
+struct VertexArrayTraits
+{
+    using Handle = GLuint;
+    static void destroy(GLuint vao) { glDeleteVertexArrays(1, &vao); }
+};
+
+struct FramebufferTraits
+{
+    using Handle = GLuint;
+    static void destroy(GLuint framebuffer) { glDeleteFramebuffers(1, &framebuffer); }
+};
+
+struct RenderbufferTraits
+{
+    using Handle = GLuint;
+    static void destroy(GLuint renderbuffer) { glDeleteRenderbuffers(1, &renderbuffer); }
+};
+
+struct QueryTraits
+{
+    using Handle = GLuint;
+    static void destroy(GLuint query) { glDeleteQueries(1, &query); }
+};
+
+struct FenceTraits
+{
+    using Handle = GLsync;
+    static void destroy(GLsync fence) { glDeleteSync(fence); }
+};
+
+using Buffer = GLObject<BufferTraits>;
+using Program = GLObject<ProgramTraits>;
+using VertexArray = GLObject<VertexArrayTraits>;
+using Framebuffer = GLObject<FramebufferTraits>;
+using Renderbuffer = GLObject<RenderbufferTraits>;
+using Query = GLObject<QueryTraits>;
+using Fence = GLObject<FenceTraits>;
+
+// Immutable storage buffer created with direct state access
+[[nodiscard]]
+Buffer make_buffer(GLsizeiptr size, const void *data, GLbitfield flags);
+
+[[nodiscard]]
+VertexArray make_vertex_array();
+
+[[nodiscard]]
+Framebuffer make_framebuffer();
+
+// Renderbuffer with storage of the given format and size
+[[nodiscard]]
+Renderbuffer make_renderbuffer(GLenum format, GLsizei width, GLsizei height);
+
+[[nodiscard]]
+Query make_query(GLenum target);
+
+[[nodiscard]]
+Fence make_fence();
+
+// Versions of a uniform block in a persistently mapped buffer, bound to a fixed binding point.
+// A new version goes to the next slot, waiting only if the GPU may still read that slot.
+struct UniformRing
+{
+    static constexpr std::size_t RING_SIZE = 3;
+
+    Buffer buffer;
+    std::byte *mapped = nullptr;
+    GLsizeiptr block_size = 0;
+    GLsizeiptr slot_size = 0; // block size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    GLuint binding = 0;
+
+    std::array<Fence, RING_SIZE> fences;
+    std::size_t slot = 0;
+    bool written = false;
+};
+
+[[nodiscard]]
+UniformRing make_uniform_ring(GLsizeiptr block_size, GLuint binding);
+
+// Write a new version of the block and bind it
+void update_uniform_ring(UniformRing &ring, const void *block);
+
+template <typename T>
+void update_uniform_ring(UniformRing &ring, const T &block)
+{
+    assert(sizeof(T) == static_cast<std::size_t>(ring.block_size));
+    update_uniform_ring(ring, static_cast<const void *>(&block));
+}
@@ -0,0 +1,95 @@
+#include "gravity.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+void accumulate_accelerations(std::span<const glm::vec4> targets, std::size_t targets_offset,
+                              std::span<const glm::vec4> sources, std::size_t sources_offset,
+                              float gravity, float softening, std::span<glm::dvec3> accelerations)
+{
+    double eps_sq = static_cast<double>(softening) * softening;
+
+    parallel_for(targets.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            glm::dvec3 position(targets[i]);
+            glm::dvec3 acceleration(0.0);
+
+            for (std::size_t j = 0; j < sources.size(); ++j)
+            {
+                if (targets_offset + i == sources_offset + j)
+                {
+                    continue;
+                }
+
+                glm::dvec3 dpos = glm::dvec3(sources[j]) - position;
+                double distance_sq = glm::dot(dpos, dpos) + eps_sq;
+                double inv_r = 1.0 / std::sqrt(distance_sq);
+                acceleration += (sources[j].w * inv_r * inv_r * inv_r) * dpos;
+            }
+
+            accelerations[i] += static_cast<double>(gravity) * acceleration;
+        }
+    });
+}
+
+// Softened direct sum on body i in single precision, the same update as compute.glsl
+[[nodiscard]]
+static glm::vec3 direct_acceleration(std::span<const glm::vec4> positions_and_masses, std::size_t i, float gravity, float eps_sq)
+{
+    glm::vec3 position(positions_and_masses[i]);
+    glm::vec3 acceleration(0.0f);
+
+    for (std::size_t j = 0; j < positions_and_masses.size(); ++j)
+    {
+        if (i == j)
+        {
+            continue;
+        }
+
+        glm::vec3 dpos = glm::vec3(positions_and_masses[j]) - position;
+        float distance_sq = glm::dot(dpos, dpos) + eps_sq;
+        float inv_r = 1.0f / std::sqrt(distance_sq);
+        acceleration += (gravity * positions_and_masses[j].w * inv_r * inv_r * inv_r) * dpos;
+    }
+
+    return acceleration;
+}
+
+void step_direct(std::span<glm::vec4> positions_and_masses, std::span<glm::vec4> velocities,
+                 float dt, float gravity, float softening, std::vector<glm::vec4> &scratch)
+{
+    float eps_sq = softening * softening;
+    scratch.resize(positions_and_masses.size());
+
+    for (std::size_t i = 0; i < positions_and_masses.size(); ++i)
+    {
+        glm::vec3 acceleration = direct_acceleration(positions_and_masses, i, gravity, eps_sq);
+        glm::vec3 velocity = glm::vec3(velocities[i]) + acceleration * dt;
+        velocities[i] = glm::vec4(velocity, velocities[i].w);
+        scratch[i] = glm::vec4(glm::vec3(positions_and_masses[i]) + velocity * dt, positions_and_masses[i].w);
+    }
+
+    std::copy(scratch.begin(), scratch.end(), positions_and_masses.begin());
+}
+
+void step_direct_parallel(std::span<glm::vec4> positions_and_masses, std::span<glm::vec4> velocities,
+                          float dt, float gravity, float softening, std::vector<glm::vec4> &scratch)
+{
+    float eps_sq = softening * softening;
+    scratch.resize(positions_and_masses.size());
+
+    parallel_for(positions_and_masses.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 acceleration = direct_acceleration(positions_and_masses, i, gravity, eps_sq);
+            glm::vec3 velocity = glm::vec3(velocities[i]) + acceleration * dt;
+            velocities[i] = glm::vec4(velocity, velocities[i].w);
+            scratch[i] = glm::vec4(glm::vec3(positions_and_masses[i]) + velocity * dt, positions_and_masses[i].w);
+        }
+    });
+
+    std::copy(scratch.begin(), scratch.end(), positions_and_masses.begin());
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+// CPU gravity backend, same softened direct sum as compute.glsl
+
+// Accumulate in double precision the accelerations that sources exert on targets.
+// Offsets are the global indices of the first target / source, used to skip self-interaction.
+void accumulate_accelerations(std::span<const glm::vec4> targets, std::size_t targets_offset,
+                              std::span<const glm::vec4> sources, std::size_t sources_offset,
+                              float gravity, float softening, std::span<glm::dvec3> accelerations);
+
+// One symplectic Euler step in single precision on the calling thread, the same update as compute.glsl.
+// scratch holds the new positions until every acceleration has been computed.
+void step_direct(std::span<glm::vec4> positions_and_masses, std::span<glm::vec4> velocities,
+                 float dt, float gravity, float softening, std::vector<glm::vec4> &scratch);
+
+// The same step with the bodies split over the worker threads
+void step_direct_parallel(std::span<glm::vec4> positions_and_masses, std::span<glm::vec4> velocities,
+                          float dt, float gravity, float softening, std::vector<glm::vec4> &scratch);
@@ -0,0 +1,220 @@
+#include "halo_finder.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <utility>
+
+// Uniform grid hashed into a power of two table, bodies sorted by bucket
+struct HashGrid
+{
+    float cell_size = 1.0f;
+    uint32_t mask = 0;
+    std::vector<uint32_t> bucket_starts; // bodies of bucket b are indices[bucket_starts[b], bucket_starts[b + 1])
+    std::vector<uint32_t> indices;
+};
+
+[[nodiscard]]
+static glm::ivec3 cell_of(const glm::vec4 &position, float cell_size)
+{
+    return glm::ivec3(glm::floor(glm::vec3(position) / cell_size));
+}
+
+[[nodiscard]]
+static uint32_t hash_cell(const glm::ivec3 &cell, uint32_t mask)
+{
+    uint32_t h = static_cast<uint32_t>(cell.x) * 73856093u ^ static_cast<uint32_t>(cell.y) * 19349663u ^ static_cast<uint32_t>(cell.z) * 83492791u;
+    return h & mask;
+}
+
+[[nodiscard]]
+static HashGrid make_hash_grid(std::span<const glm::vec4> positions_and_masses, float cell_size)
+{
+    HashGrid grid;
+    grid.cell_size = cell_size;
+
+    std::size_t buckets = std::bit_ceil(std::max<std::size_t>(positions_and_masses.size(), 1));
+    grid.mask = static_cast<uint32_t>(buckets - 1);
+
+    std::vector<uint32_t> body_buckets(positions_and_masses.size());
+    parallel_for(positions_and_masses.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            body_buckets[i] = hash_cell(cell_of(positions_and_masses[i], cell_size), grid.mask);
+        }
+    });
+
+    // Counting sort by bucket
+    grid.bucket_starts.assign(buckets + 1, 0);
+    for (uint32_t bucket : body_buckets)
+    {
+        ++grid.bucket_starts[bucket + 1];
+    }
+    for (std::size_t b = 0; b < buckets; ++b)
+    {
+        grid.bucket_starts[b + 1] += grid.bucket_starts[b];
+    }
+
+    std::vector<uint32_t> offsets(grid.bucket_starts.begin(), grid.bucket_starts.end() - 1);
+    grid.indices.resize(positions_and_masses.size());
+    for (std::size_t i = 0; i < body_buckets.size(); ++i)
+    {
+        grid.indices[offsets[body_buckets[i]]++] = static_cast<uint32_t>(i);
+    }
+
+    return grid;
+}
+
+// Root of i, halving the path on the way. A failed exchange only means another thread moved it first.
+[[nodiscard]]
+static uint32_t find_root(std::vector<std::atomic<uint32_t>> &parents, uint32_t i)
+{
+    while (true)
+    {
+        uint32_t parent = parents[i].load(std::memory_order_relaxed);
+        if (parent == i)
+        {
+            return i;
+        }
+
+        uint32_t grandparent = parents[parent].load(std::memory_order_relaxed);
+        if (grandparent != parent)
+        {
+            parents[i].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+        }
+        i = grandparent;
+    }
+}
+
+// Roots always link to the smaller index, so no cycle can form
+static void unite(std::vector<std::atomic<uint32_t>> &parents, uint32_t a, uint32_t b)
+{
+    while (true)
+    {
+        a = find_root(parents, a);
+        b = find_root(parents, b);
+        if (a == b)
+        {
+            return;
+        }
+        if (a < b)
+        {
+            std::swap(a, b);
+        }
+
+        uint32_t expected = a;
+        if (parents[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+        {
+            return;
+        }
+    }
+}
+
+std::vector<Halo> find_halos(std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities,
+                             float linking_length, std::size_t min_members)
+{
+    std::size_t count = positions_and_masses.size();
+    HashGrid grid = make_hash_grid(positions_and_masses, linking_length);
+    float linking_length_sq = linking_length * linking_length;
+
+    std::vector<std::atomic<uint32_t>> parents(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        parents[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+    }
+
+    // Each pair is linked once, from its smaller index
+    parallel_for(count, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 position(positions_and_masses[i]);
+            glm::ivec3 cell = cell_of(positions_and_masses[i], grid.cell_size);
+
+            for (int dz = -1; dz <= 1; ++dz)
+            for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                uint32_t bucket = hash_cell(cell + glm::ivec3(dx, dy, dz), grid.mask);
+                for (uint32_t k = grid.bucket_starts[bucket]; k < grid.bucket_starts[bucket + 1]; ++k)
+                {
+                    uint32_t j = grid.indices[k];
+                    if (j <= i)
+                    {
+                        continue;
+                    }
+
+                    glm::vec3 dpos = glm::vec3(positions_and_masses[j]) - position;
+                    if (glm::dot(dpos, dpos) <= linking_length_sq)
+                    {
+                        unite(parents, static_cast<uint32_t>(i), j);
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<uint32_t> roots(count);
+    parallel_for(count, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            roots[i] = find_root(parents, static_cast<uint32_t>(i));
+        }
+    });
+
+    // Accumulate per root in double precision
+    struct Group
+    {
+        double mass = 0.0;
+        glm::dvec3 weighted_position{0.0};
+        glm::dvec3 momentum{0.0};
+        std::size_t member_count = 0;
+    };
+
+    std::vector<Group> groups(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Group &group = groups[roots[i]];
+        double mass = positions_and_masses[i].w;
+        group.mass += mass;
+        group.weighted_position += mass * glm::dvec3(positions_and_masses[i]);
+        group.momentum += mass * glm::dvec3(velocities[i]);
+        ++group.member_count;
+    }
+
+    std::vector<Halo> halos;
+    for (const Group &group : groups)
+    {
+        if (group.member_count < std::max<std::size_t>(min_members, 1) || group.mass <= 0.0)
+        {
+            continue;
+        }
+
+        Halo halo;
+        halo.mass = static_cast<float>(group.mass);
+        halo.center = glm::vec3(group.weighted_position / group.mass);
+        halo.velocity = glm::vec3(group.momentum / group.mass);
+        halo.member_count = group.member_count;
+        halos.push_back(halo);
+    }
+
+    std::sort(halos.begin(), halos.end(), [](const Halo &a, const Halo &b) { return a.mass > b.mass; });
+    return halos;
+}
+
+void write_halo_catalogue(std::ostream &output, std::size_t step, std::span<const Halo> halos)
+{
+    output << std::format("# step {} halos {}\n", step, halos.size());
+    for (const Halo &halo : halos)
+    {
+        output << std::format("{:.6e} {:.6e} {:.6e} {:.6e} {:.6e} {:.6e} {:.6e} {}\n",
+                              halo.mass, halo.center.x, halo.center.y, halo.center.z,
+                              halo.velocity.x, halo.velocity.y, halo.velocity.z, halo.member_count);
+    }
+    output.flush();
+}
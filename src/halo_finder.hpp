@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Friends-of-friends group: bodies closer than the linking length belong to the same halo
+struct Halo
+{
+    float mass = 0.0f;
+    glm::vec3 center{0.0f};   // center of mass
+    glm::vec3 velocity{0.0f}; // mass weighted mean velocity
+    std::size_t member_count = 0;
+};
+
+// Halos of at least min_members bodies, heaviest first. Neighbours come from a spatial hash grid
+// with cells of the linking length, groups are joined with a lock-free union-find.
+[[nodiscard]]
+std::vector<Halo> find_halos(std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities,
+                             float linking_length, std::size_t min_members);
+
+// One block per call: "# step <step> halos <n>" then one "mass x y z vx vy vz members" line per halo
+void write_halo_catalogue(std::ostream &output, std::size_t step, std::span<const Halo> halos);
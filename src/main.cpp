@@ -8,20 +8,39 @@
 #include <format>
 #include <filesystem>
 #include <cmath>
+#include <optional>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <span>
+#include <algorithm>
+#include <array>
 #include "shader.hpp"
 #include "camera.hpp"
 #include "scene.hpp"
 #include "constants.hpp"
 #include "error_log.hpp"
-
-struct ComputeUniforms
-{
-    GLint count;
-    GLint dt;
-    GLint gravity;
-    GLint iter_per_frame;
-    GLint softening;
-};
+#include "merging.hpp"
+#include "splat_renderer.hpp"
+#include "frame_exporter.hpp"
+#include "options.hpp"
+#include "out_of_core.hpp"
+#include "ensemble.hpp"
+#include "diagnostics.hpp"
+#include "snapshot_readback.hpp"
+#include "halo_finder.hpp"
+#include "trajectory.hpp"
+#include "trajectory_player.hpp"
+#include "precision.hpp"
+#include "gl_resources.hpp"
+#include "simulation_parameters.hpp"
+#include "step_batch.hpp"
+#include "scene_description.hpp"
+#include "validation.hpp"
+#include "autotune.hpp"
+#include "gravity.hpp"
+#include "tree.hpp"
+#include "potential.hpp"
 
 struct RenderUniforms
 {
@@ -33,8 +52,16 @@ struct Input
 {
     bool reloaded_shaders = true;
     bool middle_button_pressed = false;
+    bool left_button_pressed = false;
     bool first_motion = true;
     bool pause_simulation = true;
+    bool merge_bodies = false;
+    bool splat_rendering = false;
+    bool diagnostics = false;
+    bool relative_precision = false;
+    bool adaptive_softening = false;
+    bool submission_timings = false;
+    StepMode step_mode = StepMode::PerStep;
     float xpos = 0.0f;
     float ypos = 0.0f;
 };
@@ -44,18 +71,67 @@ static Input input;
 static Camera camera;
 
 // Shader related
-static GLuint compute_program = 0;
-static GLuint render_program = 0;
+static Program compute_program;
+static Program render_program;
+static Merger merger;
+static SplatRenderer splat_renderer;
+static DiagnosticsPass diagnostics_pass;
+static std::optional<TrajectoryPlayer> trajectory_player;
+static RelativeIntegrator relative_integrator;
+static StepBatcher step_batcher;
+static PotentialKernel potential_kernel;
+static bool replaying = false;
 static const std::filesystem::path COMPUTE_SHADER_FILEPATH = "../shaders/compute.glsl";
 static const std::filesystem::path VERTEX_SHADER_FILEPATH = "../shaders/vertex.glsl";
 static const std::filesystem::path FRAGMENT_SHADER_FILEPATH = "../shaders/fragment.glsl";
 
 // Work group size
 static constexpr GLuint WORKGROUP_SIZE = 128;
-static constexpr GLuint NUM_GROUPS_X = (Scene::COUNT + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
 static constexpr GLuint NUM_GROUPS_Y = 1;
 static constexpr GLuint NUM_GROUPS_Z = 1;
 
+// Frames between two splat timing reports
+static constexpr std::size_t SPLAT_TIMINGS_INTERVAL = 120;
+
+// Substeps between two submission timing reports
+static constexpr std::size_t SUBMISSION_TIMINGS_INTERVAL = 600;
+
+// Step mode benchmark: body counts where launch overhead dominates, steps per batch of about a frame
+static constexpr std::array<std::size_t, 3> STEP_BENCHMARK_COUNTS = {256, 1024, 4096};
+static constexpr std::size_t STEP_BENCHMARK_BATCH = 16;
+
+// GLFW and the window of the run. Declared right after glfwInit, so the GL objects of main are
+// released before it, while the context is still current, whichever way main returns.
+struct WindowSession
+{
+    GLFWwindow *window = nullptr;
+
+    WindowSession() = default;
+    WindowSession(const WindowSession &) = delete;
+    WindowSession &operator=(const WindowSession &) = delete;
+
+    ~WindowSession()
+    {
+        // The programs and passes are static, they would otherwise outlive the context. Those never
+        // created hold no handle and make no GL call, GLAD may not even be loaded.
+        compute_program.reset();
+        render_program.reset();
+        merger = Merger{};
+        relative_integrator = RelativeIntegrator{};
+        step_batcher = StepBatcher{};
+        splat_renderer = SplatRenderer{};
+        diagnostics_pass = DiagnosticsPass{};
+        potential_kernel = PotentialKernel{};
+        trajectory_player.reset();
+
+        if (window)
+        {
+            glfwDestroyWindow(window);
+        }
+        glfwTerminate();
+    }
+};
+
 static constexpr std::string_view debug_source_to_string(GLenum source) noexcept
 {
     switch (source)
@@ -150,15 +226,101 @@ static void glfw_key_callback(GLFWwindow *window, int key, int scancode, int act
 
     if (key == GLFW_KEY_R && action == GLFW_PRESS)
     {
-        compute_program = reload_compute_shader_program(compute_program, COMPUTE_SHADER_FILEPATH);
-        render_program = reload_shader_program(render_program, VERTEX_SHADER_FILEPATH, FRAGMENT_SHADER_FILEPATH);
-        input.reloaded_shaders = (compute_program != 0) || (render_program != 0);
+        compute_program.reset(reload_compute_shader_program(compute_program.release(), COMPUTE_SHADER_FILEPATH));
+        render_program.reset(reload_shader_program(render_program.release(), VERTEX_SHADER_FILEPATH, FRAGMENT_SHADER_FILEPATH));
+        reload_merger_programs(merger);
+        reload_splat_programs(splat_renderer);
+        reload_diagnostics_program(diagnostics_pass);
+        reload_relative_program(relative_integrator);
+        reload_step_batcher_programs(step_batcher);
+        reload_potential_program(potential_kernel);
+        input.reloaded_shaders = compute_program || render_program;
     }
 
     if (key == GLFW_KEY_S && action == GLFW_PRESS)
     {
         input.pause_simulation = !input.pause_simulation;
     }
+
+    if (key == GLFW_KEY_M && action == GLFW_PRESS)
+    {
+        input.merge_bodies = !input.merge_bodies;
+        std::cout << std::format("Merging {}\n", input.merge_bodies ? "enabled" : "disabled");
+    }
+
+    // Playback controls
+    if (replaying && (action == GLFW_PRESS || action == GLFW_REPEAT))
+    {
+        std::size_t frame = current_frame(*trajectory_player);
+        switch (key)
+        {
+        case GLFW_KEY_UP:
+            trajectory_player->speed *= 2.0;
+            break;
+        case GLFW_KEY_DOWN:
+            trajectory_player->speed *= 0.5;
+            break;
+        case GLFW_KEY_LEFT:
+            seek_trajectory(*trajectory_player, frame > 0 ? frame - 1 : 0);
+            break;
+        case GLFW_KEY_RIGHT:
+            seek_trajectory(*trajectory_player, frame + 1);
+            break;
+        case GLFW_KEY_HOME:
+            seek_trajectory(*trajectory_player, 0);
+            break;
+        case GLFW_KEY_END:
+            seek_trajectory(*trajectory_player, frame_count(*trajectory_player) - 1);
+            break;
+        default:
+            break;
+        }
+
+        if (key == GLFW_KEY_UP || key == GLFW_KEY_DOWN || key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT || key == GLFW_KEY_HOME || key == GLFW_KEY_END)
+        {
+            std::cout << std::format("Frame {}/{} | Speed x{}\n", current_frame(*trajectory_player), frame_count(*trajectory_player), trajectory_player->speed);
+        }
+    }
+
+    if (key == GLFW_KEY_C && action == GLFW_PRESS && input.adaptive_softening)
+    {
+        std::cout << "Precision: plain fp32, cell-relative is not used with adaptive softening\n";
+    }
+    else if (key == GLFW_KEY_C && action == GLFW_PRESS)
+    {
+        input.relative_precision = !input.relative_precision;
+        std::cout << std::format("Precision: {}\n", input.relative_precision ? "cell-relative" : "plain fp32");
+    }
+
+    if (key == GLFW_KEY_D && action == GLFW_PRESS)
+    {
+        input.diagnostics = !input.diagnostics;
+        std::cout << std::format("Diagnostics {}\n", input.diagnostics ? "enabled" : "disabled");
+    }
+
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    {
+        input.step_mode = static_cast<StepMode>((static_cast<int>(input.step_mode) + 1) % 3);
+        std::cout << std::format("Step mode: {}\n", step_mode_to_string(input.step_mode));
+    }
+
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+    {
+        input.submission_timings = !input.submission_timings;
+        std::cout << std::format("Submission timings {}\n", input.submission_timings ? "enabled" : "disabled");
+    }
+
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        input.splat_rendering = !input.splat_rendering;
+        std::cout << std::format("Rendering mode: {}\n", input.splat_rendering ? "splat" : "points");
+    }
+
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    {
+        splat_renderer.density_lod = !splat_renderer.density_lod;
+        std::cout << std::format("Density LOD {}\n", splat_renderer.density_lod ? "enabled" : "disabled");
+    }
 }
 
 static void glfw_mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
@@ -171,6 +333,11 @@ static void glfw_mouse_button_callback(GLFWwindow *window, int button, int actio
     {
         input.middle_button_pressed = false;
     }
+
+    if (button == GLFW_MOUSE_BUTTON_LEFT)
+    {
+        input.left_button_pressed = action == GLFW_PRESS;
+    }
 }
 
 static void glfw_mouse_motion_callback(GLFWwindow *window, double xpos, double ypos)
@@ -193,6 +360,15 @@ static void glfw_mouse_motion_callback(GLFWwindow *window, double xpos, double y
         camera.phi = std::clamp(camera.phi, -0.5f * PI + 0.01f, 0.5f * PI - 0.01f);
     }
 
+    // Scrub through the recording, the window width spans the whole of it
+    if (replaying && input.left_button_pressed)
+    {
+        int width = 0;
+        int height = 0;
+        glfwGetWindowSize(window, &width, &height);
+        scrub_trajectory(*trajectory_player, width > 0 ? xpos / width : 0.0);
+    }
+
     input.xpos = xpos;
     input.ypos = ypos;
 }
@@ -209,33 +385,282 @@ std::string vec3_to_string(const glm::vec3 &v)
     return "Vec3(x=" + std::to_string(v.x) + ", y=" + std::to_string(v.y) + ", z=" + std::to_string(v.z) + ")";
 }
 
-int main()
+// Headless out-of-core modes, no OpenGL context needed
+[[nodiscard]]
+static int run_out_of_core(const Options &options)
+{
+    if (!options.write_particles_path.empty())
+    {
+        if (!write_particle_file(options.write_particles_path, options.write_particles_count, 42))
+        {
+            return -1;
+        }
+        std::cout << std::format("Wrote {} bodies to {}\n", options.write_particles_count, options.write_particles_path.string());
+    }
+
+    if (options.out_of_core_particles_path.empty())
+    {
+        return 0;
+    }
+
+    std::optional<OutOfCoreStats> stats = compute_accelerations_out_of_core(options.out_of_core_particles_path, options.out_of_core_accelerations_path,
+                                                                            options.block_size, Scene::GRAVITY, Scene::SOFTENING);
+    if (!stats)
+    {
+        return -1;
+    }
+
+    double interactions = static_cast<double>(stats->count) * static_cast<double>(stats->count);
+    std::cout << std::format("Out-of-core: {} bodies, block size {}\n", stats->count, options.block_size);
+    std::cout << std::format("Read {:.2f} GB | I/O {:.3f} s | Compute {:.3f} s | Wall {:.3f} s\n",
+                             stats->bytes_read * 1e-9, stats->io_seconds, stats->compute_seconds, stats->wall_seconds);
+    std::cout << std::format("I/O hidden behind compute: {:.1f}% | {:.3f} G interactions/s\n",
+                             100.0 * io_overlap(*stats), interactions * 1e-9 / stats->wall_seconds);
+
+    return 0;
+}
+
+// Total energy of every ensemble member
+[[nodiscard]]
+static std::vector<float> ensemble_energies(const Ensemble &ensemble)
+{
+    std::vector<float> energies;
+    energies.reserve(ensemble.members.size());
+    for (std::size_t e = 0; e < ensemble.members.size(); ++e)
+    {
+        std::span positions(ensemble.positions_and_masses.data() + e * ensemble.count, ensemble.count);
+        std::span velocities(ensemble.velocities.data() + e * ensemble.count, ensemble.count);
+        const EnsembleMember &member = ensemble.members[e];
+        energies.push_back(compute_diagnostics(positions, velocities, member.gravity, member.softening).total_energy());
+    }
+    return energies;
+}
+
+// Ensemble of small independent simulations, on the CPU or with one dispatch per step
+[[nodiscard]]
+static int run_ensemble(const Options &options)
+{
+    Ensemble ensemble = make_ensemble(options.ensemble_members, options.ensemble_count, 42,
+                                      options.ensemble_gravity_range, options.ensemble_softening_range);
+    std::vector<float> initial_energies = ensemble_energies(ensemble);
+
+    bool cpu = options.gravity_backend == GravityBackend::Cpu;
+    EnsembleStats stats = cpu ? run_ensemble_cpu(ensemble, options.ensemble_steps, Scene::DT)
+                              : run_ensemble_gpu(ensemble, options.ensemble_steps, Scene::DT);
+    if (stats.seconds <= 0.0)
+    {
+        return -1;
+    }
+
+    std::cout << std::format("Ensemble ({}): {} simulations x {} bodies x {} steps in {:.3f} s\n",
+                             cpu ? "CPU" : "GPU", stats.simulations, stats.count, stats.steps, stats.seconds);
+    std::cout << std::format("{:.1f} simulations/hour | {:.1f} steps/s per simulation\n",
+                             simulations_per_hour(stats), stats.steps / stats.seconds);
+
+    std::vector<float> final_energies = ensemble_energies(ensemble);
+    float max_drift = 0.0f;
+    for (std::size_t e = 0; e < final_energies.size(); ++e)
+    {
+        max_drift = std::max(max_drift, std::abs(final_energies[e] - initial_energies[e]) / std::abs(initial_energies[e]));
+    }
+    std::cout << std::format("Max relative energy drift: {:.3e}\n", max_drift);
+
+    return 0;
+}
+
+// Plain fp32 against cell-relative integration of the same scene
+[[nodiscard]]
+static int run_precision_compare(const Options &options)
+{
+    std::optional<PrecisionReport> report = run_precision_comparison(options.precision_compare_count, options.precision_compare_steps);
+    if (!report)
+    {
+        return -1;
+    }
+
+    std::cout << std::format("Precision comparison: {} bodies, {} steps\n", options.precision_compare_count, options.precision_compare_steps);
+    std::cout << "Mode          | Max acc. error | RMS acc. error | Energy drift | Steps/s\n";
+    for (const auto &[name, mode] : {std::pair{"plain fp32", report->plain}, std::pair{"cell-relative", report->relative}})
+    {
+        std::cout << std::format("{:<13} | {:>14.3e} | {:>14.3e} | {:>12.3e} | {:.1f}\n",
+                                 name, mode.max_acceleration_error, mode.rms_acceleration_error, mode.energy_drift, mode.steps_per_second);
+    }
+
+    return 0;
+}
+
+static int run_step_mode_benchmark(const Options &options)
+{
+    std::vector<std::size_t> counts(STEP_BENCHMARK_COUNTS.begin(), STEP_BENCHMARK_COUNTS.end());
+    std::optional<std::vector<StepBenchmarkReport>> reports = run_step_benchmark(counts, options.step_benchmark_steps, STEP_BENCHMARK_BATCH, options.persistent_groups);
+    if (!reports)
+    {
+        return -1;
+    }
+
+    std::cout << std::format("Step modes: {} steps, {} steps per batch, {} persistent groups\n",
+                             options.step_benchmark_steps, STEP_BENCHMARK_BATCH, options.persistent_groups);
+    std::cout << "Bodies | Mode       | Steps/s   | Max deviation\n";
+    for (const StepBenchmarkReport &report : *reports)
+    {
+        for (const StepModeReport &mode : report.modes)
+        {
+            std::cout << std::format("{:>6} | {:<10} | {:>9.1f} | {:.3e}{}\n", report.count, step_mode_to_string(mode.mode), mode.steps_per_second,
+                                     mode.max_deviation, mode.barrier_failed ? " (grid barrier failed)" : "");
+        }
+    }
+
+    return 0;
+}
+
+// Regression checks of the force backends, the GLSL ones unless --validate-cpu asked for the CPU ones only
+[[nodiscard]]
+static int run_validation_mode(const Options &options, bool gpu)
+{
+    if (gpu)
+    {
+        std::cout << std::format("Validation on {}\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    }
+    else
+    {
+        std::cout << "Validation of the CPU backends only\n";
+    }
+
+    ValidationSettings settings;
+    settings.gpu = gpu;
+    settings.baseline_path = options.baseline_path;
+    settings.update_baseline = options.update_baseline;
+    settings.throughput_tolerance = options.throughput_tolerance;
+
+    std::optional<std::vector<ValidationCheck>> checks = run_validation(settings);
+    if (!checks)
+    {
+        return -1;
+    }
+
+    std::size_t failed = 0;
+    for (const ValidationCheck &check : *checks)
+    {
+        std::cout << std::format("{} | {:<34} | {}\n", check.passed ? "PASS" : "FAIL", check.name, check.detail);
+        failed += check.passed ? 0 : 1;
+    }
+    std::cout << std::format("{} checks, {} failed\n", checks->size(), failed);
+
+    return failed == 0 ? 0 : -1;
+}
+
+// Generate a described scene straight into mapped storage buffers, the bodies are never copied
+[[nodiscard]]
+static bool generate_scene_buffers(const SceneDescription &description, const Buffer &positions_and_masses, const Buffer &velocities, const Buffer &colors)
+{
+    std::size_t count = description.count();
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    auto map = [size](const Buffer &buffer)
+    {
+        return static_cast<glm::vec4 *>(glMapNamedBufferRange(buffer.get(), 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    };
+
+    std::array<glm::vec4 *, 3> mapped = {map(positions_and_masses), map(velocities), map(colors)};
+    bool all_mapped = std::all_of(mapped.begin(), mapped.end(), [](glm::vec4 *pointer) { return pointer != nullptr; });
+    if (all_mapped)
+    {
+        auto start = std::chrono::steady_clock::now();
+        generate_scene(description, SceneOutput{{mapped[0], count}, {mapped[1], count}, {mapped[2], count}});
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::format("Generated {} bodies in {:.3f} s\n", count, seconds);
+    }
+    else
+    {
+        log_error(ErrorType::ResourceCreation, "Cannot map the scene buffers");
+    }
+
+    const std::array<const Buffer *, 3> buffers = {&positions_and_masses, &velocities, &colors};
+    for (std::size_t i = 0; i < buffers.size(); ++i)
+    {
+        if (mapped[i])
+        {
+            glUnmapNamedBuffer(buffers[i]->get());
+        }
+    }
+
+    return all_mapped;
+}
+
+int main(int argc, char **argv)
 {
+    std::optional<Options> parsed_options = parse_options(argc, argv);
+    if (!parsed_options)
+    {
+        return -1;
+    }
+    const Options &options = *parsed_options;
+    input.splat_rendering = options.splat_rendering;
+    input.merge_bodies = options.merge_bodies;
+    input.diagnostics = options.diagnostics_interval > 0;
+    input.relative_precision = options.relative_precision;
+    input.adaptive_softening = options.adaptive_softening;
+    input.step_mode = options.step_mode;
+    std::size_t diagnostics_interval = options.diagnostics_interval > 0 ? options.diagnostics_interval : Scene::DIAGNOSTICS_INTERVAL;
+
+    if (!options.write_particles_path.empty() || !options.out_of_core_particles_path.empty())
+    {
+        return run_out_of_core(options);
+    }
+
+    bool ensemble_mode = options.ensemble_members > 0;
+    if (ensemble_mode && options.gravity_backend == GravityBackend::Cpu)
+    {
+        return run_ensemble(options);
+    }
+
+    // Raw frames go to stdout, keep logs out of the stream
+    bool exporting = !options.export_path.empty();
+    if (options.export_path == "-")
+    {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
     std::cout << "Hello World\n";
     
     camera.phi = glm::radians(30.0f);
 
     glfwSetErrorCallback(glfw_error_callback);
 
+    // The CPU-only validation needs no context. Otherwise a missing context fails, the GLSL backends are never skipped.
+    bool validating = options.validate;
+    if (options.validate_cpu_only)
+    {
+        return run_validation_mode(options, false);
+    }
     if (!glfwInit())
     {
         return -1;
     }
+    WindowSession session;
     std::cout << "GLFW Init OK\n";
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    // Validation only needs compute shaders and direct state access, which llvmpipe exposes from 4.5
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, validating ? 5 : 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // Exports, ensembles and the comparisons run offscreen, the window only provides the context
+    bool precision_compare = options.precision_compare_count > 0;
+    bool step_benchmark = options.step_benchmark_steps > 0;
+    if (exporting || ensemble_mode || precision_compare || step_benchmark || validating)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
     int width = 1280;
     int height = 720;
 
     GLFWwindow *window = glfwCreateWindow(width, height, "Compute Shader", nullptr, nullptr);
     if (!window)
     {
-        glfwTerminate();
         return -1;
     }
+    session.window = window;
     std::cout << "GLFW Window OK\n";
 
     glfwSetKeyCallback(window, glfw_key_callback);
@@ -261,96 +686,629 @@ int main()
 
     glfwSwapInterval(1);
 
-    compute_program = make_compute_shader_program(COMPUTE_SHADER_FILEPATH);
-    if (compute_program == GL_FALSE)
+    if (ensemble_mode)
     {
-        return -1;
+        return run_ensemble(options);
+    }
+    else if (precision_compare)
+    {
+        return run_precision_compare(options);
+    }
+    else if (step_benchmark)
+    {
+        return run_step_mode_benchmark(options);
+    }
+    else if (validating)
+    {
+        return run_validation_mode(options, true);
     }
 
-    render_program = make_shader_program(VERTEX_SHADER_FILEPATH, FRAGMENT_SHADER_FILEPATH);
-    if (render_program == GL_FALSE)
+    compute_program.reset(make_compute_shader_program(COMPUTE_SHADER_FILEPATH));
+    if (!compute_program)
     {
         return -1;
     }
 
-    // Uniforms for compute shader
-    glUseProgram(compute_program);
-    ComputeUniforms compute_uniforms;
-    compute_uniforms.count = glGetUniformLocation(compute_program, "count");
-    compute_uniforms.dt = glGetUniformLocation(compute_program, "dt");
-    compute_uniforms.gravity = glGetUniformLocation(compute_program, "gravity");
-    compute_uniforms.iter_per_frame = glGetUniformLocation(compute_program, "iter_per_frame");
-    compute_uniforms.softening = glGetUniformLocation(compute_program, "softening");
-
-    assert(compute_uniforms.count != -1);
-    assert(compute_uniforms.dt != -1);
-    assert(compute_uniforms.gravity != -1);
-    assert(compute_uniforms.iter_per_frame != -1);
-    assert(compute_uniforms.softening != -1);
+    render_program.reset(make_shader_program(VERTEX_SHADER_FILEPATH, FRAGMENT_SHADER_FILEPATH));
+    if (!render_program)
+    {
+        return -1;
+    }
 
     // Uniforms for render shader
-    glUseProgram(render_program);
+    glUseProgram(render_program.get());
     RenderUniforms render_uniforms;
-    render_uniforms.mvp = glGetUniformLocation(render_program, "mvp");
+    render_uniforms.mvp = glGetUniformLocation(render_program.get(), "mvp");
 
     assert(render_uniforms.mvp != -1);
 
+    // Recorded trajectory, the scene only sizes the buffers
+    if (!options.replay_path.empty())
+    {
+        trajectory_player = make_trajectory_player(options.replay_path);
+        if (!trajectory_player)
+        {
+            return -1;
+        }
+        replaying = true;
+        std::cout << std::format("Replaying {} frames of up to {} bodies\n", frame_count(*trajectory_player), trajectory_player->capacity);
+    }
+
+    // Scene file, generated straight into the buffers
+    std::optional<SceneDescription> description;
+    if (!options.scene_path.empty())
+    {
+        description = load_scene_description(options.scene_path);
+        if (!description)
+        {
+            return -1;
+        }
+    }
+
+    // Bodies the buffers and passes are sized for
+    std::size_t body_count = replaying ? trajectory_player->capacity : description ? description->count() : Scene::COUNT;
+    GLsizeiptr body_buffer_size = static_cast<GLsizeiptr>(body_count * sizeof(glm::vec4));
+
+    // Storage, written by the GPU once created. Positions and velocities are also updated by the CPU
+    // gravity backends.
+    Buffer positions_in_storage;
+    Buffer velocities_storage;
+    Buffer colors_storage;
+    if (description)
+    {
+        positions_in_storage = make_buffer(body_buffer_size, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+        velocities_storage = make_buffer(body_buffer_size, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+        colors_storage = make_buffer(body_buffer_size, nullptr, GL_MAP_WRITE_BIT);
+        if (!generate_scene_buffers(*description, positions_in_storage, velocities_storage, colors_storage))
+        {
+            return -1;
+        }
+        std::cout << std::format("Scene '{}': {} bodies in {} components\n", options.scene_path.string(), body_count, description->components.size());
+    }
+    else
+    {
+        // Input data for compute shader, released once uploaded
+        Scene scene = replaying ? Scene(body_count) : create_sun_collapse(42, body_count);
+        positions_in_storage = make_buffer(body_buffer_size, scene.positions_and_masses.data(), GL_DYNAMIC_STORAGE_BIT);
+        velocities_storage = make_buffer(body_buffer_size, scene.velocities.data(), GL_DYNAMIC_STORAGE_BIT);
+        colors_storage = make_buffer(body_buffer_size, scene.colors.data(), 0);
+    }
+    Buffer positions_out_storage = make_buffer(body_buffer_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
     // Input buffers
-    GLuint positions_and_masses_in = 0;
-    GLuint velocities_buffer = 0;
-    GLuint colors_buffer = 0;
+    GLuint positions_and_masses_in = positions_in_storage.get();
+    GLuint velocities_buffer = velocities_storage.get();
+    GLuint colors_buffer = colors_storage.get();
 
     // Output buffers
-    GLuint positions_and_masses_out = 0;
-
-    // Input data for compute shader
-    Scene scene = create_sun_collapse(42);
-
-    glGenBuffers(1, &positions_and_masses_in);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, positions_and_masses_in);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, Scene::COUNT * sizeof(scene.positions_and_masses[0]), scene.positions_and_masses.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_and_masses_in);
-
-    glGenBuffers(1, &velocities_buffer);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocities_buffer);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, Scene::COUNT * sizeof(scene.velocities[0]), scene.velocities.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocities_buffer);
-
-    glGenBuffers(1, &colors_buffer);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, colors_buffer);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, Scene::COUNT * sizeof(scene.colors[0]), scene.colors.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, colors_buffer);
-
-    glGenBuffers(1, &positions_and_masses_out);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, positions_and_masses_out);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, Scene::COUNT * sizeof(scene.positions_and_masses[0]), nullptr, GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, positions_and_masses_out);
-
-    // Unbind
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-    // Rendering
-    GLuint vao = 0;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, positions_and_masses_in);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)0);
-    glBindVertexArray(0);
+    GLuint positions_and_masses_out = positions_out_storage.get();
+
+    // Storage bindings 0-3 of compute.glsl for both ping-pong parities, bound with a single call per
+    // step. Recorded again when merging swaps the colors buffer.
+    BindingSets binding_sets{};
+    std::size_t parity = 0;
+    auto record_binding_sets = [&]()
+    {
+        GLuint positions_a = parity == 0 ? positions_and_masses_in : positions_and_masses_out;
+        GLuint positions_b = parity == 0 ? positions_and_masses_out : positions_and_masses_in;
+        binding_sets[0] = {positions_a, velocities_buffer, colors_buffer, positions_b};
+        binding_sets[1] = {positions_b, velocities_buffer, colors_buffer, positions_a};
+    };
+    record_binding_sets();
+
+    // Simulation parameters, a new version is only written when one of them changes
+    UniformRing parameters_ring = make_uniform_ring(sizeof(SimulationParameters), SIMULATION_PARAMETERS_BINDING);
+    if (!parameters_ring.mapped)
+    {
+        log_error(ErrorType::ResourceCreation, "Cannot map the simulation parameters");
+        return -1;
+    }
+    SimulationParameters parameters;
+    parameters.dt = Scene::DT;
+    parameters.gravity = Scene::GRAVITY;
+    parameters.softening = Scene::SOFTENING;
+    parameters.iter_per_frame = Scene::ITER_PER_FRAME;
+    bool parameters_written = false;
+
+    // CPU time spent submitting substeps, reported with T
+    double submission_seconds = 0.0;
+    std::size_t submission_steps = 0;
+
+    // Merging and compaction
+    merger = make_merger(body_count);
+
+    // Batched step modes
+    step_batcher = make_step_batcher(static_cast<GLuint>(body_count), options.persistent_groups);
+    if (!step_batcher.persistent_program)
+    {
+        return -1;
+    }
+
+    // Force kernel with per body softening that also outputs the energies of the bodies
+    potential_kernel = make_potential_kernel(body_count);
+    if (!potential_kernel.program)
+    {
+        return -1;
+    }
+
+    // Cell-relative precision mode, cells and offsets are rebuilt from the positions when it starts
+    relative_integrator = make_relative_integrator(body_count);
+    bool relative_split = false;
+    GLuint live_count = replaying ? 0 : static_cast<GLuint>(body_count);
+    std::size_t step = 0;
+
+    // Splat rendering
+    splat_renderer = make_splat_renderer();
+
+    // Conservation diagnostics, drift is relative to the first report
+    diagnostics_pass = make_diagnostics_pass(body_count);
+    std::optional<float> initial_energy;
+
+    // In-situ halo finder, fed by an asynchronous snapshot readback and run on a worker thread
+    bool find_halos_enabled = !options.halo_catalogue_path.empty();
+    std::ofstream halo_catalogue;
+    if (find_halos_enabled)
+    {
+        halo_catalogue.open(options.halo_catalogue_path);
+        if (!halo_catalogue)
+        {
+            log_error(ErrorType::HaloFinder, std::format("Cannot open '{}'", options.halo_catalogue_path.string()));
+            return -1;
+        }
+    }
+    SnapshotReadback halo_readback = make_snapshot_readback(body_count);
+    std::future<void> halo_task;
+
+    // Trajectory recording, same readback path, frames are encoded on a worker thread
+    bool recording = !options.record_path.empty();
+    TrajectoryWriter trajectory_writer;
+    if (recording)
+    {
+        trajectory_writer = make_trajectory_writer(options.record_path, options.record_bits, options.keyframe_interval);
+        if (!trajectory_writer.output.is_open())
+        {
+            return -1;
+        }
+    }
+    SnapshotReadback record_readback = make_snapshot_readback(body_count);
+    std::future<void> record_task;
+    std::size_t dropped_record_frames = 0;
+
+    // Rendering, the vertex shader reads the storage buffers, the VAO has no attribute
+    VertexArray vao = make_vertex_array();
+
+    // CPU gravity backends, the bodies are read back before a batch of steps and uploaded after it
+    GravityBackend gravity_backend = options.gravity_backend;
+    float tree_theta = options.theta;
+    std::vector<glm::vec4> cpu_positions;
+    std::vector<glm::vec4> cpu_velocities;
+    std::vector<glm::vec4> cpu_scratch;
+    Octree cpu_tree;
+    auto read_bodies = [&]()
+    {
+        GLsizeiptr size = static_cast<GLsizeiptr>(live_count * sizeof(glm::vec4));
+        cpu_positions.resize(live_count);
+        cpu_velocities.resize(live_count);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glGetNamedBufferSubData(positions_and_masses_in, 0, size, cpu_positions.data());
+        glGetNamedBufferSubData(velocities_buffer, 0, size, cpu_velocities.data());
+    };
+
+    // Auto backend: cost models fitted on this scene and hardware, the choice is revisited as it evolves
+    bool auto_backend = options.auto_backend && !replaying;
+    BackendTuner backend_tuner;
+    auto retune_backend = [&](double steps_per_batch)
+    {
+        backend_tuner.steps_per_batch = steps_per_batch;
+        read_bodies();
+        std::vector<BackendEstimate> estimates = estimate_backends(backend_tuner, cpu_positions);
+        bool changed = select_backend(backend_tuner, estimates);
+        gravity_backend = backend_tuner.backend;
+        tree_theta = backend_tuner.theta;
+
+        std::string summary;
+        for (const BackendEstimate &estimate : estimates)
+        {
+            summary += std::format(" | {} {:.2f} ms (error {:.1e})", gravity_backend_to_string(estimate.backend), 1e3 * estimate.seconds, estimate.force_error);
+        }
+        std::cout << std::format("Step {} | backend {}{}{}{}\n", step, gravity_backend_to_string(gravity_backend),
+                                 gravity_backend == GravityBackend::Tree ? std::format(" (theta {:.2f})", tree_theta) : "",
+                                 changed ? " (switched)" : "", summary);
+    };
+
+    // Adaptive softening lengths from the current bodies, written to the w lane of the velocities
+    bool adaptive_softening = options.adaptive_softening && !replaying;
+    auto update_softening_lengths = [&]()
+    {
+        read_bodies();
+        build_octree(cpu_tree, cpu_positions);
+        assign_softening_lengths(cpu_tree, Scene::ADAPTIVE_SOFTENING_FACTOR, Scene::SOFTENING, Scene::ADAPTIVE_SOFTENING_MAX, cpu_velocities);
+        glNamedBufferSubData(velocities_buffer, 0, static_cast<GLsizeiptr>(live_count * sizeof(glm::vec4)), cpu_velocities.data());
+    };
+    if (adaptive_softening)
+    {
+        update_softening_lengths();
+    }
+
+    // Steps run by compute_potential.glsl, one per dispatch: every GPU step with adaptive softening,
+    // otherwise the plain fp32 steps a diagnostics pass follows, which then sums their energies
+    // instead of running its own pair loop
+    bool energies_current = false;
+    auto potential_step = [&](std::size_t next_step)
+    {
+        return gravity_backend == GravityBackend::Gpu &&
+               (adaptive_softening || (!input.relative_precision && input.diagnostics && next_step % diagnostics_interval == 0));
+    };
+
+    // Steps until the next one a merge, diagnostics, halo, record or softening pass is due on
+    auto steps_to_next_pass = [&]()
+    {
+        std::size_t steps = StepBatcher::MAX_STEPS;
+        auto until = [&](bool enabled, std::size_t interval)
+        {
+            if (enabled)
+            {
+                steps = std::min(steps, interval - step % interval);
+            }
+        };
+        until(input.merge_bodies, Scene::MERGE_INTERVAL);
+        until(input.diagnostics, diagnostics_interval);
+        until(find_halos_enabled, options.halo_interval);
+        until(recording, options.record_interval);
+        until(auto_backend, options.retune_interval);
+        until(adaptive_softening, Scene::ADAPTIVE_SOFTENING_INTERVAL);
+        return steps;
+    };
+
+    // Steps the CPU backends run between two transfers: those of a frame, cut on the steps a pass is due on.
+    // In real time a frame runs about one step of Scene::DT.
+    auto expected_batch_steps = [&]()
+    {
+        std::size_t frame_steps = exporting ? options.steps_per_frame : 1;
+        return static_cast<double>(std::max<std::size_t>(std::min(frame_steps, steps_to_next_pass()), 1));
+    };
+
+    if (auto_backend)
+    {
+        read_bodies();
+        backend_tuner = calibrate_backends(cpu_positions, compute_program.get(), options.force_error_target);
+        parameters_written = false; // the calibration wrote its own parameters
+        retune_backend(expected_batch_steps());
+    }
+
+    // k simulation steps: dispatch, swap, then the passes due on the last step, such as a merge every
+    // Scene::MERGE_INTERVAL steps. k is 1 unless a batched step mode is on, see run_steps.
+    auto simulate_steps = [&](std::size_t k)
+    {
+        auto submission_start = std::chrono::steady_clock::now();
+        energies_current = false;
+
+        if (gravity_backend != GravityBackend::Gpu)
+        {
+            // The result goes to the buffer the positions are read from after k steps
+            read_bodies();
+            for (std::size_t i = 0; i < k; ++i)
+            {
+                if (gravity_backend == GravityBackend::Tree)
+                {
+                    step_tree(cpu_positions, cpu_velocities, Scene::DT, Scene::GRAVITY, Scene::SOFTENING, tree_theta, cpu_tree, cpu_scratch);
+                }
+                else
+                {
+                    step_direct_parallel(cpu_positions, cpu_velocities, Scene::DT, Scene::GRAVITY, Scene::SOFTENING, cpu_scratch);
+                }
+            }
+
+            GLsizeiptr size = static_cast<GLsizeiptr>(live_count * sizeof(glm::vec4));
+            glNamedBufferSubData(k % 2 == 1 ? positions_and_masses_out : positions_and_masses_in, 0, size, cpu_positions.data());
+            glNamedBufferSubData(velocities_buffer, 0, size, cpu_velocities.data());
+            relative_split = false;
+        }
+        else if (input.relative_precision && !adaptive_softening)
+        {
+            // Rebind buffers, other passes use the same binding points
+            glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, binding_sets[parity].data());
+            if (!relative_split)
+            {
+                split_positions(relative_integrator, positions_and_masses_in, live_count);
+                relative_split = true;
+            }
+            step_relative(relative_integrator, positions_and_masses_out, velocities_buffer, live_count, Scene::DT, Scene::GRAVITY, Scene::SOFTENING);
+        }
+        else
+        {
+            relative_split = false;
+
+            if (!parameters_written || parameters.count != live_count || parameters.step_count != k)
+            {
+                parameters.count = live_count;
+                parameters.step_count = static_cast<GLuint>(k);
+                update_uniform_ring(parameters_ring, parameters);
+                parameters_written = true;
+            }
+
+            if (potential_step(step + k))
+            {
+                dispatch_potential_step(potential_kernel, binding_sets, parity, live_count);
+                energies_current = true;
+            }
+            else
+            {
+                // One dispatch of the compute shader, from the given parity
+                auto dispatch_step = [&](std::size_t step_parity)
+                {
+                    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, binding_sets[step_parity].data());
+                    glUseProgram(compute_program.get());
+                    GLuint num_groups_x = (live_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+                    glDispatchCompute(num_groups_x, NUM_GROUPS_Y, NUM_GROUPS_Z);
+                    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+                };
+
+                switch (input.step_mode)
+                {
+                case StepMode::PerStep:
+                    dispatch_step(parity);
+                    break;
+                case StepMode::Indirect:
+                    queue_indirect_steps(compute_program.get(), merger.live_count.get(), binding_sets, parity, k);
+                    break;
+                case StepMode::Persistent:
+                    // The bodies are back at the start of the batch when it failed, its steps run one per dispatch
+                    if (!run_persistent_steps(step_batcher, binding_sets, parity, live_count))
+                    {
+                        log_error(ErrorType::Synchronization, "The persistent kernel gave up on its grid barrier, lower --persistent-groups. "
+                                                              "Falling back to per-step dispatches");
+                        input.step_mode = StepMode::PerStep;
+                        for (std::size_t i = 0; i < k; ++i)
+                        {
+                            dispatch_step((parity + i) % 2);
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (k % 2 == 1)
+        {
+            std::swap(positions_and_masses_in, positions_and_masses_out);
+        }
+        parity = (parity + k) % 2;
+
+        submission_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - submission_start).count();
+        submission_steps += k;
+        if (submission_steps >= SUBMISSION_TIMINGS_INTERVAL)
+        {
+            if (input.submission_timings)
+            {
+                std::cout << std::format("Submission {:.2f} us/step\n", 1e6 * submission_seconds / submission_steps);
+            }
+            submission_seconds = 0.0;
+            submission_steps = 0;
+        }
+
+        // Merge close bodies. The live count of a merge is read back without stalling once the GPU is
+        // done with it, the emptied slots are massless until then. The next merge waits for it.
+        step += k;
+        bool merge_due = input.merge_bodies && step % Scene::MERGE_INTERVAL == 0;
+        if (std::optional<GLuint> merged_count = read_live_count(merger, merge_due))
+        {
+            if (*merged_count != live_count)
+            {
+                std::cout << std::format("Live bodies: {}\n", *merged_count);
+            }
+            live_count = *merged_count;
+        }
+        if (merge_due)
+        {
+            merge_bodies(merger, live_count, Scene::MERGE_RADIUS, positions_and_masses_in, positions_and_masses_out, velocities_buffer, colors_storage);
+            colors_buffer = colors_storage.get();
+            record_binding_sets();
+
+            // Positions were rewritten and compacted, energies are indexed by the bodies before compaction
+            relative_split = false;
+            energies_current = false;
+        }
+
+        if (input.diagnostics && step % diagnostics_interval == 0)
+        {
+            dispatch_diagnostics(diagnostics_pass, positions_and_masses_in, velocities_buffer, live_count, Scene::GRAVITY, Scene::SOFTENING, step,
+                                 energies_current ? potential_kernel.energies.get() : 0);
+        }
+
+        // Skipped while the previous snapshot is still in flight
+        if (find_halos_enabled && step % options.halo_interval == 0)
+        {
+            request_snapshot(halo_readback, positions_and_masses_in, velocities_buffer, live_count, step);
+        }
+
+        if (recording && step % options.record_interval == 0)
+        {
+            if (!request_snapshot(record_readback, positions_and_masses_in, velocities_buffer, live_count, step))
+            {
+                ++dropped_record_frames;
+            }
+        }
+
+        if (auto_backend && step % options.retune_interval == 0)
+        {
+            retune_backend(expected_batch_steps());
+        }
+
+        if (adaptive_softening && step % Scene::ADAPTIVE_SOFTENING_INTERVAL == 0)
+        {
+            update_softening_lengths();
+        }
+    };
+
+    // n simulation steps in the current step mode, batches end on the steps a pass is due on
+    auto run_steps = [&](std::size_t n)
+    {
+        while (n > 0)
+        {
+            // The auto backend may switch between two batches
+            bool batched = gravity_backend != GravityBackend::Gpu || (input.step_mode != StepMode::PerStep && !input.relative_precision && !adaptive_softening);
+            std::size_t k = batched ? std::min(n, steps_to_next_pass()) : 1;
+
+            // The last step of the batch needs compute_potential.glsl, it runs on its own
+            if (k > 1 && potential_step(step + k))
+            {
+                --k;
+            }
+            simulate_steps(k);
+            n -= k;
+        }
+    };
+
+    // Hand a finished snapshot to the halo finder once the previous catalogue entry is written
+    auto process_halos = [&]()
+    {
+        if (halo_task.valid() && halo_task.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return;
+        }
+
+        std::optional<Snapshot> snapshot = poll_snapshot(halo_readback);
+        if (!snapshot)
+        {
+            return;
+        }
+
+        halo_task = std::async(std::launch::async, [&halo_catalogue, linking_length = options.linking_length, snapshot = std::move(*snapshot)]()
+        {
+            std::vector<Halo> halos = find_halos(snapshot.positions_and_masses, snapshot.velocities, linking_length, Scene::HALO_MIN_MEMBERS);
+            write_halo_catalogue(halo_catalogue, snapshot.step, halos);
+            std::cout << std::format("Step {} | {} halos | largest {} bodies\n", snapshot.step, halos.size(), halos.empty() ? 0 : halos.front().member_count);
+        });
+    };
+
+    // Encode a finished snapshot once the previous frame is written, frames stay in order
+    auto process_record = [&]()
+    {
+        if (record_task.valid() && record_task.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return;
+        }
+
+        std::optional<Snapshot> snapshot = poll_snapshot(record_readback);
+        if (!snapshot)
+        {
+            return;
+        }
+
+        record_task = std::async(std::launch::async, [&trajectory_writer, snapshot = std::move(*snapshot)]()
+        {
+            write_trajectory_frame(trajectory_writer, snapshot.step, snapshot.positions_and_masses, snapshot.velocities);
+        });
+    };
+
+    // Print the diagnostics the GPU has finished, never waits
+    auto report_diagnostics = [&]()
+    {
+        while (std::optional<std::pair<std::size_t, Diagnostics>> result = poll_diagnostics(diagnostics_pass))
+        {
+            const auto &[diagnostics_step, diagnostics] = *result;
+            if (!initial_energy)
+            {
+                initial_energy = diagnostics.total_energy();
+            }
+
+            float drift = (diagnostics.total_energy() - *initial_energy) / std::abs(*initial_energy);
+            std::cout << std::format("Step {} | E {:.6e} (drift {:+.3e}) | K {:.4e} | W {:.4e} | 2K/|W| {:.4f}\n",
+                                     diagnostics_step, diagnostics.total_energy(), drift,
+                                     diagnostics.kinetic_energy, diagnostics.potential_energy, diagnostics.virial_ratio());
+            std::cout << std::format("    |P| {:.4e} | |L| {:.4e} | COM {}\n",
+                                     glm::length(diagnostics.momentum), glm::length(diagnostics.angular_momentum), vec3_to_string(diagnostics.center_of_mass));
+        }
+    };
+
+    // Draw the bodies to the bound framebuffer
+    auto render_frame = [&](int frame_width, int frame_height)
+    {
+        glm::mat4 mvp = mvp_matrix(camera, static_cast<float>(frame_width), static_cast<float>(frame_height));
+
+        glViewport(0, 0, frame_width, frame_height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (input.splat_rendering)
+        {
+            render_splats(splat_renderer, positions_and_masses_in, colors_buffer, live_count, mvp, frame_width, frame_height);
+
+            if (splat_renderer.frame % SPLAT_TIMINGS_INTERVAL == 0)
+            {
+                std::cout << std::format("Splat {:.3f} ms | Resolve {:.3f} ms\n", splat_renderer.splat_ms, splat_renderer.resolve_ms);
+            }
+        }
+        else
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            glDepthMask(GL_FALSE);
+
+            glUseProgram(render_program.get());
+            glUniformMatrix4fv(render_uniforms.mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+            glBindVertexArray(vao.get());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_and_masses_in);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, colors_buffer);
+            glDrawArrays(GL_POINTS, 0, live_count);
+
+            // After render
+            glDepthMask(GL_TRUE);
+            glDisable(GL_BLEND);
+        }
+    };
+
+    // Offscreen export: fixed steps per frame, decoupled from wall clock time
+    bool export_failed = false;
+    if (exporting)
+    {
+        FrameExporter exporter = make_frame_exporter(options.export_path, options.export_width, options.export_height);
+        if (!exporter.output)
+        {
+            return -1;
+        }
+
+        std::cout << std::format("Exporting {} frames at {}x{}\n", options.export_frames, exporter.width, exporter.height);
+        double start_time = glfwGetTime();
+
+        for (std::size_t frame = 0; frame < options.export_frames && !exporter.failed && !glfwWindowShouldClose(window); ++frame)
+        {
+            run_steps(options.steps_per_frame);
+
+            begin_export_frame(exporter);
+            render_frame(exporter.width, exporter.height);
+            end_export_frame(exporter);
+
+            report_diagnostics();
+            process_halos();
+            process_record();
+            glfwPollEvents();
+        }
+
+        finish_frame_export(exporter);
+        export_failed = exporter.failed;
+
+        double elapsed = glfwGetTime() - start_time;
+        std::cout << std::format("Exported {} frames in {:.2f} s ({:.2f} fps)\n", exporter.frames_written, elapsed, exporter.frames_written / elapsed);
+    }
 
     // Simulation time
     double current_time = 0.0;
     double last_time = 0.0;
     double acc = 0.0;
 
-    std::cout << "Main loop start\n";
+    if (!exporting)
+    {
+        std::cout << "Main loop start\n";
+    }
 
     // Main loop
-    while (!glfwWindowShouldClose(window))
+    while (!exporting && !glfwWindowShouldClose(window))
     {
         glfwGetFramebufferSize(window, &width, &height);
         current_time = glfwGetTime();
-        acc += current_time - last_time;
+        double frame_time = std::min(current_time - last_time, 0.25);
+        acc += frame_time;
         last_time = current_time;
 
         if (acc >= 0.25)
@@ -358,66 +1316,60 @@ int main()
             acc = 0.25;
         }
 
-        while (acc >= Scene::DT && !input.pause_simulation)
+        // Playback replaces the simulation, S pauses it as well
+        if (replaying)
         {
-            // Rebind buffers
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_and_masses_in);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocities_buffer);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, colors_buffer);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, positions_and_masses_out);
-
-            // Launch compute shader
-            glUseProgram(compute_program);
-            glUniform1ui(compute_uniforms.count, Scene::COUNT);
-            glUniform1f(compute_uniforms.dt, Scene::DT);
-            glUniform1f(compute_uniforms.gravity, Scene::GRAVITY);
-            glUniform1ui(compute_uniforms.iter_per_frame, Scene::ITER_PER_FRAME);
-            glUniform1f(compute_uniforms.softening, Scene::SOFTENING);
-
-            glDispatchCompute(NUM_GROUPS_X, NUM_GROUPS_Y, NUM_GROUPS_Z);
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
-
-            std::swap(positions_and_masses_in, positions_and_masses_out);
+            if (!input.pause_simulation)
+            {
+                advance_playback(*trajectory_player, frame_time);
+            }
+            if (update_trajectory_player(*trajectory_player, positions_and_masses_in))
+            {
+                live_count = trajectory_player->shown_count;
+            }
+        }
 
-            acc -= Scene::DT;
+        if (!replaying && !input.pause_simulation)
+        {
+            std::size_t steps = static_cast<std::size_t>(acc / Scene::DT);
+            run_steps(steps);
+            acc -= steps * Scene::DT;
         }
 
         // Rendering
-        glm::mat4 mvp = mvp_matrix(camera, static_cast<float>(width), static_cast<float>(height));
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_ONE, GL_ONE);
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glDepthMask(GL_FALSE);
-
-        glUseProgram(render_program);
-        glUniformMatrix4fv(render_uniforms.mvp, 1, GL_FALSE, glm::value_ptr(mvp));
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, positions_and_masses_in);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, colors_buffer);
-        glDrawArrays(GL_POINTS, 0, Scene::COUNT);
-
-        // After render
-        glDepthMask(GL_TRUE);
-        glDisable(GL_BLEND);
+        render_frame(width, height);
+        report_diagnostics();
+        process_halos();
+        process_record();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    // Cleanup
-    glDeleteBuffers(1, &positions_and_masses_in);
-    glDeleteBuffers(1, &velocities_buffer);
-    glDeleteBuffers(1, &colors_buffer);
-    glDeleteBuffers(1, &positions_and_masses_out);
-    glDeleteVertexArrays(1, &vao);
-    glDeleteProgram(compute_program);
+    // Cleanup, the GL objects of main are released as they go out of scope, the static passes with the session
+    if (halo_task.valid())
+    {
+        halo_task.wait();
+    }
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (recording)
+    {
+        if (record_task.valid())
+        {
+            record_task.wait();
+        }
+
+        std::size_t frames = trajectory_writer.index.size();
+        if (finish_trajectory(trajectory_writer) && frames > 0)
+        {
+            std::cout << std::format("Trajectory: {} frames ({} dropped) | ratio {:.2f}:1 | max error position {:.4g} velocity {:.4g} | encode {:.2f} ms/frame\n",
+                                     frames, dropped_record_frames, compression_ratio(trajectory_writer),
+                                     trajectory_writer.max_position_error, trajectory_writer.max_velocity_error,
+                                     1000.0 * trajectory_writer.encode_seconds / frames);
+        }
+    }
 
     std::cout << "Goodbye World\n";
 
-    return 0;
+    return export_failed ? -1 : 0;
 }
\ No newline at end of file
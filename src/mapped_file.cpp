@@ -0,0 +1,188 @@
+#include "mapped_file.hpp"
+#include "error_log.hpp"
+#include <algorithm>
+#include <format>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+[[nodiscard]]
+static MappedFile map_file(const std::filesystem::path &filepath, bool writable, std::size_t size)
+{
+    MappedFile file;
+
+    DWORD access = writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+    DWORD creation = writable ? CREATE_ALWAYS : OPEN_EXISTING;
+    HANDLE handle = CreateFileW(filepath.c_str(), access, FILE_SHARE_READ, nullptr, creation, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        log_error(ErrorType::FileMapping, std::format("Cannot open '{}'", filepath.string()));
+        return file;
+    }
+    file.file_handle = handle;
+
+    if (!writable)
+    {
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(handle, &file_size);
+        size = static_cast<std::size_t>(file_size.QuadPart);
+    }
+    file.size = size;
+
+    if (size == 0)
+    {
+        return file;
+    }
+
+    DWORD protection = writable ? PAGE_READWRITE : PAGE_READONLY;
+    HANDLE mapping = CreateFileMappingW(handle, nullptr, protection, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), nullptr);
+    if (!mapping)
+    {
+        log_error(ErrorType::FileMapping, std::format("Cannot map '{}'", filepath.string()));
+        unmap_file(file);
+        return file;
+    }
+    file.mapping_handle = mapping;
+
+    file.data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+    if (!file.data)
+    {
+        log_error(ErrorType::FileMapping, std::format("Cannot map '{}'", filepath.string()));
+        unmap_file(file);
+    }
+
+    return file;
+}
+
+void unmap_file(MappedFile &file)
+{
+    if (file.data)
+    {
+        UnmapViewOfFile(file.data);
+    }
+    if (file.mapping_handle)
+    {
+        CloseHandle(file.mapping_handle);
+    }
+    if (file.file_handle)
+    {
+        CloseHandle(file.file_handle);
+    }
+    file = MappedFile{};
+}
+
+void prefetch_range(const MappedFile &, std::size_t, std::size_t)
+{
+}
+
+void release_range(const MappedFile &, std::size_t, std::size_t)
+{
+}
+
+#else
+
+[[nodiscard]]
+static MappedFile map_file(const std::filesystem::path &filepath, bool writable, std::size_t size)
+{
+    MappedFile file;
+
+    file.fd = writable ? open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : open(filepath.c_str(), O_RDONLY);
+    if (file.fd < 0)
+    {
+        log_error(ErrorType::FileMapping, std::format("Cannot open '{}'", filepath.string()));
+        return file;
+    }
+
+    if (writable)
+    {
+        if (ftruncate(file.fd, static_cast<off_t>(size)) != 0)
+        {
+            log_error(ErrorType::FileMapping, std::format("Cannot resize '{}' to {} bytes", filepath.string(), size));
+            unmap_file(file);
+            return file;
+        }
+    }
+    else
+    {
+        struct stat info;
+        fstat(file.fd, &info);
+        size = static_cast<std::size_t>(info.st_size);
+    }
+    file.size = size;
+
+    if (size == 0)
+    {
+        return file;
+    }
+
+    int protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void *data = mmap(nullptr, size, protection, MAP_SHARED, file.fd, 0);
+    if (data == MAP_FAILED)
+    {
+        log_error(ErrorType::FileMapping, std::format("Cannot map '{}'", filepath.string()));
+        unmap_file(file);
+        return file;
+    }
+    file.data = data;
+
+    return file;
+}
+
+void unmap_file(MappedFile &file)
+{
+    if (file.data)
+    {
+        munmap(file.data, file.size);
+    }
+    if (file.fd >= 0)
+    {
+        close(file.fd);
+    }
+    file = MappedFile{};
+}
+
+// madvise ranges must start on a page boundary
+static void advise_range(const MappedFile &file, std::size_t offset, std::size_t length, int advice)
+{
+    if (!file.data || offset >= file.size)
+    {
+        return;
+    }
+
+    std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t aligned_offset = offset - offset % page_size;
+    length = std::min(length + (offset - aligned_offset), file.size - aligned_offset);
+    posix_madvise(static_cast<char *>(file.data) + aligned_offset, length, advice);
+}
+
+void prefetch_range(const MappedFile &file, std::size_t offset, std::size_t length)
+{
+    advise_range(file, offset, length, POSIX_MADV_WILLNEED);
+}
+
+void release_range(const MappedFile &file, std::size_t offset, std::size_t length)
+{
+    advise_range(file, offset, length, POSIX_MADV_DONTNEED);
+}
+
+#endif
+
+MappedFile map_file_read(const std::filesystem::path &filepath)
+{
+    return map_file(filepath, false, 0);
+}
+
+MappedFile map_file_write(const std::filesystem::path &filepath, std::size_t size)
+{
+    return map_file(filepath, true, size);
+}
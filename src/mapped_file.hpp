@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+// Memory-mapped file
+struct MappedFile
+{
+    void *data = nullptr;
+    std::size_t size = 0;
+
+#ifdef _WIN32
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// Map an existing file read-only, data is nullptr on failure
+[[nodiscard]]
+MappedFile map_file_read(const std::filesystem::path &filepath);
+
+// Create (or truncate) a file of the given size and map it read-write, data is nullptr on failure
+[[nodiscard]]
+MappedFile map_file_write(const std::filesystem::path &filepath, std::size_t size);
+
+void unmap_file(MappedFile &file);
+
+// Hint the OS to start reading a range in the background
+void prefetch_range(const MappedFile &file, std::size_t offset, std::size_t length);
+
+// Hint the OS that a range will not be needed again soon, so the page cache stays bounded
+void release_range(const MappedFile &file, std::size_t offset, std::size_t length);
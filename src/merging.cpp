@@ -0,0 +1,175 @@
+#include "merging.hpp"
+#include "shader.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <utility>
+#include <glm/glm.hpp>
+
+static const std::filesystem::path MERGE_SHADER_FILEPATH = "../shaders/merge.glsl";
+static const std::filesystem::path SCAN_SHADER_FILEPATH = "../shaders/scan.glsl";
+static const std::filesystem::path COMPACT_SHADER_FILEPATH = "../shaders/compact.glsl";
+
+static constexpr GLuint64 LIVE_COUNT_TIMEOUT_NS = 1'000'000'000;
+
+[[nodiscard]]
+static Buffer make_scratch_buffer(std::size_t size)
+{
+    return make_buffer(static_cast<GLsizeiptr>(size), nullptr, 0);
+}
+
+[[nodiscard]]
+static GLuint num_groups(GLuint count, GLuint group_size)
+{
+    return (count + group_size - 1) / group_size;
+}
+
+LiveCount make_live_count(GLuint count)
+{
+    LiveCount live_count;
+    live_count.num_groups_x = num_groups(count, Merger::WORKGROUP_SIZE);
+    live_count.count = count;
+    return live_count;
+}
+
+Merger make_merger(std::size_t capacity)
+{
+    Merger merger;
+
+    merger.merge_program.reset(make_compute_shader_program(MERGE_SHADER_FILEPATH));
+    merger.scan_program.reset(make_compute_shader_program(SCAN_SHADER_FILEPATH));
+    merger.compact_program.reset(make_compute_shader_program(COMPACT_SHADER_FILEPATH));
+
+    merger.merge_targets = make_scratch_buffer(capacity * sizeof(GLuint));
+    merger.velocities_out = make_scratch_buffer(capacity * sizeof(glm::vec4));
+    merger.colors_out = make_scratch_buffer(capacity * sizeof(glm::vec4));
+
+    // At least one block sum level, the scan of a single block still writes its sum
+    std::size_t level_size = std::max<std::size_t>(capacity, 1);
+    merger.scan_levels.push_back(make_scratch_buffer(level_size * sizeof(GLuint)));
+    do
+    {
+        level_size = num_groups(static_cast<GLuint>(level_size), Merger::SCAN_BLOCK_SIZE);
+        merger.scan_levels.push_back(make_scratch_buffer(level_size * sizeof(GLuint)));
+    } while (level_size > 1);
+
+    GLbitfield read_flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    LiveCount live_count = make_live_count(static_cast<GLuint>(capacity));
+    merger.live_count = make_buffer(sizeof(LiveCount), &live_count, read_flags);
+    merger.mapped_live_count = static_cast<const LiveCount *>(glMapNamedBufferRange(merger.live_count.get(), 0, sizeof(LiveCount), read_flags));
+
+    return merger;
+}
+
+void reload_merger_programs(Merger &merger)
+{
+    merger.merge_program.reset(reload_compute_shader_program(merger.merge_program.release(), MERGE_SHADER_FILEPATH));
+    merger.scan_program.reset(reload_compute_shader_program(merger.scan_program.release(), SCAN_SHADER_FILEPATH));
+    merger.compact_program.reset(reload_compute_shader_program(merger.compact_program.release(), COMPACT_SHADER_FILEPATH));
+}
+
+// Inclusive scan of scan_levels[level], recursing on the block sums
+static void scan_level(const Merger &merger, std::size_t level, GLuint count)
+{
+    GLuint num_blocks = num_groups(count, Merger::SCAN_BLOCK_SIZE);
+
+    GLuint scan_program = merger.scan_program.get();
+    glUseProgram(scan_program);
+    glUniform1ui(glGetUniformLocation(scan_program, "count"), count);
+    glUniform1ui(glGetUniformLocation(scan_program, "stage"), 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, merger.scan_levels[level].get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, merger.scan_levels[level + 1].get());
+    glDispatchCompute(num_blocks, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if (num_blocks == 1)
+    {
+        return;
+    }
+
+    scan_level(merger, level + 1, num_blocks);
+
+    // Bindings and uniforms were overwritten by the recursion
+    glUseProgram(scan_program);
+    glUniform1ui(glGetUniformLocation(scan_program, "count"), count);
+    glUniform1ui(glGetUniformLocation(scan_program, "stage"), 1);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, merger.scan_levels[level].get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, merger.scan_levels[level + 1].get());
+    glDispatchCompute(num_blocks, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void merge_bodies(Merger &merger, GLuint count, float merge_radius, GLuint positions_in, GLuint positions_out, GLuint velocities, Buffer &colors)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    GLuint groups = num_groups(count, Merger::WORKGROUP_SIZE);
+
+    // Find targets then merge into roots, merged bodies land in positions_out / velocities_out
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_in);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, positions_out);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, merger.merge_targets.get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, merger.velocities_out.get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, merger.scan_levels[0].get());
+
+    GLuint merge_program = merger.merge_program.get();
+    glUseProgram(merge_program);
+    glUniform1ui(glGetUniformLocation(merge_program, "count"), count);
+    glUniform1f(glGetUniformLocation(merge_program, "merge_radius"), merge_radius);
+
+    for (GLuint stage = 0; stage < 2; ++stage)
+    {
+        glUniform1ui(glGetUniformLocation(merge_program, "stage"), stage);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Alive flags -> destination offsets
+    scan_level(merger, 0, count);
+
+    // Scatter survivors back to the front of the input buffers
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_in);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, colors.get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, positions_out);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, merger.colors_out.get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, merger.velocities_out.get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, merger.scan_levels[0].get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, merger.live_count.get());
+
+    glUseProgram(merger.compact_program.get());
+    glUniform1ui(glGetUniformLocation(merger.compact_program.get(), "count"), count);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT |
+                    GL_COMMAND_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+    std::swap(colors, merger.colors_out);
+
+    // No readback here, the count is picked up once this fence is signalled
+    merger.live_count_fence = make_fence();
+}
+
+std::optional<GLuint> read_live_count(Merger &merger, bool wait)
+{
+    if (!merger.live_count_fence)
+    {
+        return std::nullopt;
+    }
+
+    GLuint64 timeout = wait ? LIVE_COUNT_TIMEOUT_NS : 0;
+    GLenum status = glClientWaitSync(merger.live_count_fence.get(), GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    while (wait && status == GL_TIMEOUT_EXPIRED)
+    {
+        status = glClientWaitSync(merger.live_count_fence.get(), GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    }
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+        return std::nullopt;
+    }
+
+    merger.live_count_fence.reset();
+    return merger.mapped_live_count->count;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include <optional>
+#include <vector>
+
+// Record written by the compaction pass: the indirect dispatch of one compute.glsl step over the
+// survivors, then their count. The indirect step mode dispatches from it, so it follows merges
+// without waiting for the host.
+struct LiveCount
+{
+    GLuint num_groups_x = 0;
+    GLuint num_groups_y = 1;
+    GLuint num_groups_z = 1;
+    GLuint count = 0;
+};
+static_assert(sizeof(LiveCount) == 16);
+
+[[nodiscard]]
+LiveCount make_live_count(GLuint count);
+
+// Sink-particle merging followed by a stream compaction of the body buffers
+struct Merger
+{
+    static constexpr GLuint WORKGROUP_SIZE = 128;
+    static constexpr GLuint SCAN_BLOCK_SIZE = 1024; // 256 threads x 4 values
+
+    Program merge_program;
+    Program scan_program;
+    Program compact_program;
+
+    // Scratch buffers
+    Buffer merge_targets;
+    Buffer velocities_out;
+    Buffer colors_out;
+
+    // Level 0 holds the alive flags, level k + 1 the block sums of level k
+    std::vector<Buffer> scan_levels;
+
+    // LiveCount of the last compaction, mapped for reading once its fence is signalled
+    Buffer live_count;
+    const LiveCount *mapped_live_count = nullptr;
+    Fence live_count_fence;
+};
+
+// Create programs and scratch buffers for up to capacity bodies, the LiveCount record starts at capacity
+[[nodiscard]]
+Merger make_merger(std::size_t capacity);
+
+// Reload merge, scan and compact programs from file
+void reload_merger_programs(Merger &merger);
+
+// Merge bodies closer than merge_radius and compact the buffers.
+// Survivors are written back to positions_in / velocities, colors is swapped with the merger's compacted copy.
+// The new body count is read back later with read_live_count, until then the count bodies can still be
+// stepped: the slots past the survivors hold massless bodies in both position buffers.
+// count must be exact, read the count of the previous merge first.
+void merge_bodies(Merger &merger, GLuint count, float merge_radius, GLuint positions_in, GLuint positions_out, GLuint velocities, Buffer &colors);
+
+// Body count of the last merge once the GPU has finished it, or nothing if it was already read or is
+// still in flight and wait is false
+[[nodiscard]]
+std::optional<GLuint> read_live_count(Merger &merger, bool wait);
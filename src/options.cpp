@@ -0,0 +1,474 @@
+#include "options.hpp"
+#include "error_log.hpp"
+#include <charconv>
+#include <format>
+#include <iostream>
+#include <string_view>
+
+static constexpr std::string_view USAGE =
+    "Usage: NBody-GPU [options]\n"
+    "  --splat                 Start with the compute shader splat renderer\n"
+    "  --merge                 Start with body merging enabled\n"
+    "  --diagnostics <k>       Report energy, momentum and virial ratio every k steps\n"
+    "  --halos <file> <k>      Append a friends-of-friends halo catalogue to file every k steps\n"
+    "  --linking-length <l>    Friends-of-friends linking length (default Scene::HALO_LINKING_LENGTH)\n"
+    "  --record <file> <k>     Record a compressed trajectory, one frame every k steps\n"
+    "  --record-bits <b>       Quantisation bits per component, 1 to 24 (default 16)\n"
+    "  --keyframe-interval <m> Frames between two trajectory keyframes (default 32)\n"
+    "  --relative-precision    Start with cell-relative positions and compensated accumulation\n"
+    "  --precision-compare <n> <steps>\n"
+    "                          Compare plain fp32 and cell-relative integration of n bodies: accuracy,\n"
+    "                          energy drift and steps/s\n"
+    "  --step-mode <mode>      Step submission: per-step (default), indirect or persistent\n"
+    "  --persistent-groups <g> Workgroups of the persistent kernel, all must be resident at once (default 1)\n"
+    "  --step-benchmark <steps>\n"
+    "                          Compare the step modes at small body counts: steps/s and deviation\n"
+    "  --backend <backend>     Gravity solver: gpu (default), cpu, tree, or auto to pick the fastest one within\n"
+    "                          --force-error from a calibration, and switch as the scene evolves\n"
+    "  --theta <t>             Opening angle of the tree backend (default 0.5)\n"
+    "  --force-error <e>       RMS relative force error allowed to the auto backend (default 5e-3)\n"
+    "  --retune-interval <k>   Steps between two choices of the auto backend (default 600)\n"
+    "  --adaptive-softening    Soften each body by the spacing of the bodies around it, updated every\n"
+    "                          Scene::ADAPTIVE_SOFTENING_INTERVAL steps (gpu backend, not with --relative-precision)\n"
+    "  --scene <file>          Generate the initial conditions from a scene description file\n"
+    "  --validate              Check every force backend against a double precision reference and the\n"
+    "                          throughput baseline, exits with an error if a check fails or there is no\n"
+    "                          OpenGL context. The persistent kernel runs with one workgroup.\n"
+    "  --validate-cpu          --validate on the CPU backends only, without an OpenGL context\n"
+    "  --baseline <file>       Throughput baseline of --validate, one '<backend> <steps/s>' line per backend.\n"
+    "                          A backend without an entry fails.\n"
+    "  --update-baseline       Write the measured throughput to the baseline instead of checking it\n"
+    "  --throughput-tolerance <f>\n"
+    "                          Allowed throughput drop below the baseline, as a fraction (default 0.2)\n"
+    "  --replay <file>         Play a recorded trajectory back instead of simulating\n"
+    "  --export <file|->       Render offscreen and write raw RGB24 frames to file or stdout\n"
+    "  --export-size <w> <h>   Export resolution (default 3840 2160)\n"
+    "  --export-frames <n>     Number of frames to export (default 600)\n"
+    "  --steps-per-frame <n>   Simulation steps between two exported frames (default 1)\n"
+    "  --write-particles <file> <n>\n"
+    "                          Write n bodies to a particle file for the out-of-core mode\n"
+    "  --out-of-core <particles> <accelerations>\n"
+    "                          Double precision all-pairs accelerations of a particle file, block by block\n"
+    "  --block-size <n>        Bodies per out-of-core block (default 65536)\n"
+    "  --ensemble <e> <n>      Run e independent simulations of n bodies and report simulations per hour\n"
+    "                          with --backend gpu (default) or cpu\n"
+    "  --ensemble-steps <n>    Steps per ensemble simulation (default 1000)\n"
+    "  --ensemble-gravity <min> <max>\n"
+    "  --ensemble-softening <min> <max>\n"
+    "                          Parameters swept linearly over the ensemble members\n"
+    "  --help                  Show this message\n";
+
+template <typename T>
+[[nodiscard]]
+static bool parse_number(std::string_view text, T &value)
+{
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+std::optional<Options> parse_options(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+
+        // Number of values following the flag
+        auto has_values = [&](int n)
+        {
+            if (i + n < argc)
+            {
+                return true;
+            }
+            log_error(ErrorType::CommandLineParsing, std::format("{} expects {} value(s)", arg, n));
+            return false;
+        };
+
+        auto read_number = [&](auto &value)
+        {
+            std::string_view text{argv[++i]};
+            if (parse_number(text, value))
+            {
+                return true;
+            }
+            log_error(ErrorType::CommandLineParsing, std::format("Invalid value '{}' for {}", text, arg));
+            return false;
+        };
+
+        if (arg == "--help")
+        {
+            std::cout << USAGE;
+            return std::nullopt;
+        }
+        else if (arg == "--splat")
+        {
+            options.splat_rendering = true;
+        }
+        else if (arg == "--merge")
+        {
+            options.merge_bodies = true;
+        }
+        else if (arg == "--diagnostics")
+        {
+            if (!has_values(1) || !read_number(options.diagnostics_interval))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--halos")
+        {
+            if (!has_values(2))
+            {
+                return std::nullopt;
+            }
+            options.halo_catalogue_path = argv[++i];
+            if (!read_number(options.halo_interval))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--linking-length")
+        {
+            if (!has_values(1) || !read_number(options.linking_length))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--record")
+        {
+            if (!has_values(2))
+            {
+                return std::nullopt;
+            }
+            options.record_path = argv[++i];
+            if (!read_number(options.record_interval))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--record-bits")
+        {
+            if (!has_values(1) || !read_number(options.record_bits))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--keyframe-interval")
+        {
+            if (!has_values(1) || !read_number(options.keyframe_interval))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--relative-precision")
+        {
+            options.relative_precision = true;
+        }
+        else if (arg == "--precision-compare")
+        {
+            if (!has_values(2) || !read_number(options.precision_compare_count) || !read_number(options.precision_compare_steps))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--step-mode")
+        {
+            if (!has_values(1))
+            {
+                return std::nullopt;
+            }
+
+            std::string_view name{argv[++i]};
+            std::optional<StepMode> mode = step_mode_from_string(name);
+            if (!mode)
+            {
+                log_error(ErrorType::CommandLineParsing, std::format("Unknown step mode '{}'", name));
+                return std::nullopt;
+            }
+            options.step_mode = *mode;
+        }
+        else if (arg == "--persistent-groups")
+        {
+            if (!has_values(1) || !read_number(options.persistent_groups))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--step-benchmark")
+        {
+            if (!has_values(1) || !read_number(options.step_benchmark_steps))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--backend")
+        {
+            if (!has_values(1))
+            {
+                return std::nullopt;
+            }
+
+            std::string_view name{argv[++i]};
+            std::optional<GravityBackend> backend = gravity_backend_from_string(name);
+            options.auto_backend = name == "auto";
+            if (!backend && !options.auto_backend)
+            {
+                log_error(ErrorType::CommandLineParsing, std::format("Unknown gravity backend '{}'", name));
+                return std::nullopt;
+            }
+            options.gravity_backend = backend.value_or(GravityBackend::Gpu);
+        }
+        else if (arg == "--theta")
+        {
+            if (!has_values(1) || !read_number(options.theta))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--force-error")
+        {
+            if (!has_values(1) || !read_number(options.force_error_target))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--retune-interval")
+        {
+            if (!has_values(1) || !read_number(options.retune_interval))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--adaptive-softening")
+        {
+            options.adaptive_softening = true;
+        }
+        else if (arg == "--scene")
+        {
+            if (!has_values(1))
+            {
+                return std::nullopt;
+            }
+            options.scene_path = argv[++i];
+        }
+        else if (arg == "--validate")
+        {
+            options.validate = true;
+        }
+        else if (arg == "--validate-cpu")
+        {
+            options.validate = true;
+            options.validate_cpu_only = true;
+        }
+        else if (arg == "--baseline")
+        {
+            if (!has_values(1))
+            {
+                return std::nullopt;
+            }
+            options.baseline_path = argv[++i];
+        }
+        else if (arg == "--update-baseline")
+        {
+            options.update_baseline = true;
+        }
+        else if (arg == "--throughput-tolerance")
+        {
+            if (!has_values(1) || !read_number(options.throughput_tolerance))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--replay")
+        {
+            if (!has_values(1))
+            {
+                return std::nullopt;
+            }
+            options.replay_path = argv[++i];
+        }
+        else if (arg == "--export")
+        {
+            if (!has_values(1))
+            {
+                return std::nullopt;
+            }
+            options.export_path = argv[++i];
+        }
+        else if (arg == "--export-size")
+        {
+            if (!has_values(2) || !read_number(options.export_width) || !read_number(options.export_height))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--export-frames")
+        {
+            if (!has_values(1) || !read_number(options.export_frames))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--steps-per-frame")
+        {
+            if (!has_values(1) || !read_number(options.steps_per_frame))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--write-particles")
+        {
+            if (!has_values(2))
+            {
+                return std::nullopt;
+            }
+            options.write_particles_path = argv[++i];
+            if (!read_number(options.write_particles_count))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--out-of-core")
+        {
+            if (!has_values(2))
+            {
+                return std::nullopt;
+            }
+            options.out_of_core_particles_path = argv[++i];
+            options.out_of_core_accelerations_path = argv[++i];
+        }
+        else if (arg == "--block-size")
+        {
+            if (!has_values(1) || !read_number(options.block_size))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--ensemble")
+        {
+            if (!has_values(2) || !read_number(options.ensemble_members) || !read_number(options.ensemble_count))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--ensemble-steps")
+        {
+            if (!has_values(1) || !read_number(options.ensemble_steps))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--ensemble-gravity")
+        {
+            if (!has_values(2) || !read_number(options.ensemble_gravity_range.x) || !read_number(options.ensemble_gravity_range.y))
+            {
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--ensemble-softening")
+        {
+            if (!has_values(2) || !read_number(options.ensemble_softening_range.x) || !read_number(options.ensemble_softening_range.y))
+            {
+                return std::nullopt;
+            }
+        }
+        else
+        {
+            log_error(ErrorType::CommandLineParsing, std::format("Unknown option '{}'\n{}", arg, USAGE));
+            return std::nullopt;
+        }
+    }
+
+    if (options.export_width <= 0 || options.export_height <= 0)
+    {
+        log_error(ErrorType::CommandLineParsing, "Export size must be positive");
+        return std::nullopt;
+    }
+
+    if (options.ensemble_members > 0 && options.ensemble_count == 0)
+    {
+        log_error(ErrorType::CommandLineParsing, "Ensemble simulations need at least one body");
+        return std::nullopt;
+    }
+
+    if (options.ensemble_members > 0 && (options.gravity_backend == GravityBackend::Tree || options.auto_backend))
+    {
+        log_error(ErrorType::CommandLineParsing, "--ensemble needs the gpu or cpu backend");
+        return std::nullopt;
+    }
+
+    if (!options.halo_catalogue_path.empty() && (options.halo_interval == 0 || options.linking_length <= 0.0f))
+    {
+        log_error(ErrorType::CommandLineParsing, "Halo interval and linking length must be positive");
+        return std::nullopt;
+    }
+
+    if (!options.record_path.empty() && (options.record_interval == 0 || options.keyframe_interval == 0))
+    {
+        log_error(ErrorType::CommandLineParsing, "Record and keyframe intervals must be positive");
+        return std::nullopt;
+    }
+
+    if (options.record_bits < 1 || options.record_bits > 24)
+    {
+        log_error(ErrorType::CommandLineParsing, "Record bits must be between 1 and 24");
+        return std::nullopt;
+    }
+
+    if (!options.replay_path.empty() && (!options.export_path.empty() || !options.record_path.empty()))
+    {
+        log_error(ErrorType::CommandLineParsing, "--replay cannot be combined with --export or --record");
+        return std::nullopt;
+    }
+
+    if (!options.replay_path.empty() && !options.scene_path.empty())
+    {
+        log_error(ErrorType::CommandLineParsing, "--replay cannot be combined with --scene");
+        return std::nullopt;
+    }
+
+    if (options.theta < 0.0f || options.force_error_target <= 0.0 || options.retune_interval == 0)
+    {
+        log_error(ErrorType::CommandLineParsing, "Theta must not be negative, force error and retune interval must be positive");
+        return std::nullopt;
+    }
+
+    if (options.adaptive_softening && (options.gravity_backend != GravityBackend::Gpu || options.auto_backend))
+    {
+        log_error(ErrorType::CommandLineParsing, "--adaptive-softening needs the gpu backend");
+        return std::nullopt;
+    }
+
+    if (options.adaptive_softening && options.relative_precision)
+    {
+        log_error(ErrorType::CommandLineParsing, "--adaptive-softening cannot be combined with --relative-precision");
+        return std::nullopt;
+    }
+
+    if (options.persistent_groups == 0)
+    {
+        log_error(ErrorType::CommandLineParsing, "Persistent groups must be positive");
+        return std::nullopt;
+    }
+
+    if (options.update_baseline && options.baseline_path.empty())
+    {
+        log_error(ErrorType::CommandLineParsing, "--update-baseline needs --baseline");
+        return std::nullopt;
+    }
+
+    if (options.throughput_tolerance < 0.0 || options.throughput_tolerance >= 1.0)
+    {
+        log_error(ErrorType::CommandLineParsing, "Throughput tolerance must be in [0, 1)");
+        return std::nullopt;
+    }
+
+    if (options.block_size == 0)
+    {
+        log_error(ErrorType::CommandLineParsing, "Block size must be positive");
+        return std::nullopt;
+    }
+
+    return options;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <glm/glm.hpp>
+#include "autotune.hpp"
+#include "scene.hpp"
+#include "step_batch.hpp"
+
+// Command line options
+struct Options
+{
+    // Rendering
+    bool splat_rendering = false;
+    bool merge_bodies = false;
+
+    // Steps between two conservation diagnostics, 0 starts with them disabled
+    std::size_t diagnostics_interval = 0;
+
+    // Friends-of-friends halo catalogue written every halo_interval steps
+    std::filesystem::path halo_catalogue_path;
+    std::size_t halo_interval = 0;
+    float linking_length = Scene::HALO_LINKING_LENGTH;
+
+    // Compressed trajectory recorded every record_interval steps
+    std::filesystem::path record_path;
+    std::size_t record_interval = 0;
+    uint32_t record_bits = 16;
+    uint32_t keyframe_interval = 32;
+
+    // Cell-relative positions with compensated accumulation, and its comparison against plain fp32
+    bool relative_precision = false;
+    std::size_t precision_compare_count = 0;
+    std::size_t precision_compare_steps = 1000;
+
+    // Submission of the steps of a frame, and the benchmark of the modes at small body counts
+    StepMode step_mode = StepMode::PerStep;
+    GLuint persistent_groups = 1;
+    std::size_t step_benchmark_steps = 0;
+
+    // Gravity solver, or the tuner picks one and revisits its choice every retune_interval steps
+    GravityBackend gravity_backend = GravityBackend::Gpu;
+    bool auto_backend = false;
+    float theta = 0.5f;
+    double force_error_target = 5e-3;
+    std::size_t retune_interval = 600;
+
+    // Per body softening lengths from the local density, see potential.hpp
+    bool adaptive_softening = false;
+
+    // Scene description file instead of the built-in scene
+    std::filesystem::path scene_path;
+
+    // Accuracy and throughput regression checks of the force backends, see validation.hpp
+    bool validate = false;
+    bool validate_cpu_only = false; // skip the GLSL backends instead of failing without a context
+    std::filesystem::path baseline_path;
+    bool update_baseline = false;
+    double throughput_tolerance = 0.2;
+
+    // Play a recorded trajectory back instead of simulating
+    std::filesystem::path replay_path;
+
+    // Offscreen frame export, "-" streams to stdout
+    std::filesystem::path export_path;
+    int export_width = 3840;
+    int export_height = 2160;
+    std::size_t export_frames = 600;
+    std::size_t steps_per_frame = 1;
+
+    // Out-of-core direct summation, runs without a window
+    std::filesystem::path write_particles_path;
+    std::size_t write_particles_count = 0;
+    std::filesystem::path out_of_core_particles_path;
+    std::filesystem::path out_of_core_accelerations_path;
+    std::size_t block_size = 65536;
+
+    // Ensemble of independent simulations, runs without a visible window
+    std::size_t ensemble_members = 0;
+    std::size_t ensemble_count = 0;
+    std::size_t ensemble_steps = 1000;
+    glm::vec2 ensemble_gravity_range{Scene::GRAVITY};
+    glm::vec2 ensemble_softening_range{Scene::SOFTENING};
+};
+
+// Parse command line arguments, empty on error or --help
+[[nodiscard]]
+std::optional<Options> parse_options(int argc, char **argv);
@@ -0,0 +1,149 @@
+#include "out_of_core.hpp"
+#include "gravity.hpp"
+#include "mapped_file.hpp"
+#include "scene.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <future>
+#include <span>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]]
+static double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool write_particle_file(const std::filesystem::path &filepath, std::size_t count, uint32_t seed)
+{
+    MappedFile file = map_file_write(filepath, count * sizeof(glm::vec4));
+    if (!file.data)
+    {
+        unmap_file(file);
+        return count == 0;
+    }
+
+    // One scene worth of bodies in memory at a time
+    auto *bodies = static_cast<glm::vec4 *>(file.data);
+    std::size_t written = 0;
+    for (uint32_t chunk = 0; written < count; ++chunk)
+    {
+        Scene scene = create_sun_collapse(seed + chunk);
+        std::size_t n = std::min(Scene::COUNT, count - written);
+        std::copy_n(scene.positions_and_masses.begin(), n, bodies + written);
+        written += n;
+    }
+
+    unmap_file(file);
+    return true;
+}
+
+std::optional<OutOfCoreStats> compute_accelerations_out_of_core(const std::filesystem::path &particles_filepath,
+                                                                const std::filesystem::path &accelerations_filepath,
+                                                                std::size_t block_size, float gravity, float softening)
+{
+    MappedFile particles = map_file_read(particles_filepath);
+    if (!particles.data || block_size == 0)
+    {
+        unmap_file(particles);
+        return std::nullopt;
+    }
+
+    std::size_t count = particles.size / sizeof(glm::vec4);
+    MappedFile accelerations = map_file_write(accelerations_filepath, count * sizeof(glm::dvec4));
+    if (!accelerations.data)
+    {
+        unmap_file(particles);
+        unmap_file(accelerations);
+        return std::nullopt;
+    }
+
+    const auto *bodies = static_cast<const glm::vec4 *>(particles.data);
+    auto *output = static_cast<glm::dvec4 *>(accelerations.data);
+
+    OutOfCoreStats stats;
+    stats.count = count;
+
+    std::size_t num_blocks = (count + block_size - 1) / block_size;
+    auto block_count = [&](std::size_t block)
+    {
+        return std::min(block_size, count - block * block_size);
+    };
+
+    // Copy a block out of the mapping, then drop its pages so the resident set stays bounded
+    auto load_block = [&](std::vector<glm::vec4> &destination, std::size_t block)
+    {
+        Clock::time_point start = Clock::now();
+        std::size_t offset = block * block_size * sizeof(glm::vec4);
+        std::size_t length = block_count(block) * sizeof(glm::vec4);
+
+        prefetch_range(particles, offset, length);
+        std::copy_n(bodies + block * block_size, block_count(block), destination.begin());
+        release_range(particles, offset, length);
+
+        return seconds_since(start);
+    };
+
+    std::vector<glm::vec4> i_block(block_size);
+    std::array<std::vector<glm::vec4>, 2> j_blocks{std::vector<glm::vec4>(block_size), std::vector<glm::vec4>(block_size)};
+    std::vector<glm::dvec3> block_accelerations(block_size);
+
+    Clock::time_point wall_start = Clock::now();
+
+    // Tiles are visited in (i-block, j-block) order, tile t uses j_blocks[t % 2]
+    std::size_t num_tiles = num_blocks * num_blocks;
+    std::future<double> pending = std::async(std::launch::async, load_block, std::ref(j_blocks[0]), 0);
+
+    for (std::size_t ib = 0; ib < num_blocks; ++ib)
+    {
+        std::size_t i_count = block_count(ib);
+        stats.io_seconds += load_block(i_block, ib);
+        stats.bytes_read += i_count * sizeof(glm::vec4);
+        std::fill_n(block_accelerations.begin(), i_count, glm::dvec3(0.0));
+
+        for (std::size_t jb = 0; jb < num_blocks; ++jb)
+        {
+            std::size_t tile = ib * num_blocks + jb;
+            stats.io_seconds += pending.get();
+            stats.bytes_read += block_count(jb) * sizeof(glm::vec4);
+
+            // Double buffering: load the next j-block while this one is processed
+            if (tile + 1 < num_tiles)
+            {
+                pending = std::async(std::launch::async, load_block, std::ref(j_blocks[(tile + 1) % 2]), (tile + 1) % num_blocks);
+            }
+
+            Clock::time_point compute_start = Clock::now();
+            accumulate_accelerations(std::span(i_block.data(), i_count), ib * block_size,
+                                     std::span(j_blocks[tile % 2].data(), block_count(jb)), jb * block_size,
+                                     gravity, softening, std::span(block_accelerations.data(), i_count));
+            stats.compute_seconds += seconds_since(compute_start);
+        }
+
+        for (std::size_t k = 0; k < i_count; ++k)
+        {
+            output[ib * block_size + k] = glm::dvec4(block_accelerations[k], 0.0);
+        }
+    }
+
+    stats.wall_seconds = seconds_since(wall_start);
+
+    unmap_file(particles);
+    unmap_file(accelerations);
+
+    return stats;
+}
+
+double io_overlap(const OutOfCoreStats &stats)
+{
+    if (stats.io_seconds <= 0.0)
+    {
+        return 1.0;
+    }
+
+    double hidden = stats.io_seconds + stats.compute_seconds - stats.wall_seconds;
+    return std::clamp(hidden / stats.io_seconds, 0.0, 1.0);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+/*
+Out-of-core direct summation. The particle file is a raw array of vec4 (x, y, z, m), the same
+layout as the positions_and_masses SSBO. Accelerations are written as raw dvec4 (ax, ay, az, 0).
+Only one i-block and two j-blocks are resident at a time, the next j-block is prefetched
+while the current one is being processed.
+*/
+
+struct OutOfCoreStats
+{
+    std::size_t count = 0;
+    std::size_t bytes_read = 0;
+    double io_seconds = 0.0;      // time spent loading blocks
+    double compute_seconds = 0.0; // time spent in the pair loop
+    double wall_seconds = 0.0;
+};
+
+// Write count bodies generated chunk by chunk from create_sun_collapse
+[[nodiscard]]
+bool write_particle_file(const std::filesystem::path &filepath, std::size_t count, uint32_t seed);
+
+// All-pairs accelerations in double precision, processed in (i-block, j-block) tiles
+[[nodiscard]]
+std::optional<OutOfCoreStats> compute_accelerations_out_of_core(const std::filesystem::path &particles_filepath,
+                                                                const std::filesystem::path &accelerations_filepath,
+                                                                std::size_t block_size, float gravity, float softening);
+
+// Share of the I/O time hidden behind computation, in [0, 1]
+[[nodiscard]]
+double io_overlap(const OutOfCoreStats &stats);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+[[nodiscard]]
+inline std::size_t worker_count()
+{
+    return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Split [0, count) into one contiguous range per worker thread, calls f(begin, end)
+template <typename F>
+void parallel_for(std::size_t count, F &&f)
+{
+    std::size_t num_threads = std::min(worker_count(), count);
+    if (num_threads <= 1)
+    {
+        if (count > 0)
+        {
+            f(std::size_t{0}, count);
+        }
+        return;
+    }
+
+    std::size_t chunk = (count + num_threads - 1) / num_threads;
+    std::vector<std::jthread> threads;
+    threads.reserve(num_threads);
+
+    for (std::size_t begin = 0; begin < count; begin += chunk)
+    {
+        std::size_t end = std::min(count, begin + chunk);
+        threads.emplace_back([&f, begin, end]() { f(begin, end); });
+    }
+}
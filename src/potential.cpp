@@ -0,0 +1,94 @@
+#include "potential.hpp"
+#include "parallel.hpp"
+#include "shader.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+static const std::filesystem::path POTENTIAL_SHADER_FILEPATH = "../shaders/compute_potential.glsl";
+
+// Storage binding of the energies in compute_potential.glsl
+static constexpr GLuint ENERGIES_BINDING = 4;
+
+PotentialKernel make_potential_kernel(std::size_t capacity)
+{
+    PotentialKernel kernel;
+    kernel.program.reset(make_compute_shader_program(POTENTIAL_SHADER_FILEPATH));
+    kernel.energies = make_buffer(static_cast<GLsizeiptr>(capacity * sizeof(glm::vec2)), nullptr, 0);
+    return kernel;
+}
+
+void reload_potential_program(PotentialKernel &kernel)
+{
+    kernel.program.reset(reload_compute_shader_program(kernel.program.release(), POTENTIAL_SHADER_FILEPATH));
+}
+
+void dispatch_potential_step(const PotentialKernel &kernel, const BindingSets &binding_sets, std::size_t parity, GLuint count)
+{
+    glUseProgram(kernel.program.get());
+    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, binding_sets[parity].data());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ENERGIES_BINDING, kernel.energies.get());
+    glDispatchCompute((count + PotentialKernel::WORKGROUP_SIZE - 1) / PotentialKernel::WORKGROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void assign_softening_lengths(const Octree &tree, float factor, float min_length, float max_length, std::span<glm::vec4> velocities)
+{
+    // Nodes are depth first, a node comes after every node containing it and overwrites their lengths.
+    // The root is always used, in case the scene has fewer bodies than SOFTENING_NEIGHBOURS.
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i)
+    {
+        const OctreeNode &node = tree.nodes[i];
+        uint32_t count = node.end - node.begin;
+        if (count < SOFTENING_NEIGHBOURS && i != 0)
+        {
+            continue;
+        }
+
+        float spacing = node.size / std::cbrt(static_cast<float>(count));
+        float length = std::clamp(factor * spacing, min_length, max_length);
+        for (uint32_t j = node.begin; j < node.end; ++j)
+        {
+            velocities[tree.order[j]].w = length;
+        }
+    }
+}
+
+void accumulate_softened_potentials(std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities, float gravity,
+                                    float softening, std::span<glm::dvec3> accelerations, std::span<double> potentials)
+{
+    std::size_t count = positions_and_masses.size();
+    auto softening_sq = [&](std::size_t i)
+    {
+        double length = velocities[i].w > 0.0f ? velocities[i].w : softening;
+        return length * length;
+    };
+
+    parallel_for(count, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            glm::dvec3 position(positions_and_masses[i]);
+            double own_softening_sq = softening_sq(i);
+            glm::dvec3 acceleration(0.0);
+            double potential = 0.0;
+
+            for (std::size_t j = 0; j < count; ++j)
+            {
+                if (j == i)
+                {
+                    continue;
+                }
+
+                glm::dvec3 dpos = glm::dvec3(positions_and_masses[j]) - position;
+                double inv_r = 1.0 / std::sqrt(glm::dot(dpos, dpos) + 0.5 * (own_softening_sq + softening_sq(j)));
+                double m_inv_r = positions_and_masses[j].w * inv_r;
+                acceleration += m_inv_r * inv_r * inv_r * dpos;
+                potential += m_inv_r;
+            }
+
+            accelerations[i] = static_cast<double>(gravity) * acceleration;
+            potentials[i] = -static_cast<double>(gravity) * potential;
+        }
+    });
+}
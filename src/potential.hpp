@@ -0,0 +1,39 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include "step_batch.hpp"
+#include "tree.hpp"
+#include <cstddef>
+#include <span>
+#include <glm/glm.hpp>
+
+// compute_potential.glsl, the variant of compute.glsl with per body softening lengths, read from the w
+// lane of the velocities, that also writes the potential and kinetic energy of every body
+struct PotentialKernel
+{
+    static constexpr GLuint WORKGROUP_SIZE = 128;
+
+    Program program;
+    Buffer energies; // vec2 per body: potential, kinetic energy
+};
+
+[[nodiscard]]
+PotentialKernel make_potential_kernel(std::size_t capacity);
+
+void reload_potential_program(PotentialKernel &kernel);
+
+// One step from the given parity. The SimulationParameters block bound must hold the count.
+void dispatch_potential_step(const PotentialKernel &kernel, const BindingSets &binding_sets, std::size_t parity, GLuint count);
+
+// Adaptive softening: the length of a body is factor times the mean spacing of the bodies around it,
+// measured in the smallest tree node holding at least SOFTENING_NEIGHBOURS bodies, then clamped.
+// Bodies of sparse regions get longer lengths, so their few close encounters do not scatter them.
+static constexpr uint32_t SOFTENING_NEIGHBOURS = 32;
+
+// Write the lengths to the w lane of the velocities, tree built over the positions of the same bodies
+void assign_softening_lengths(const Octree &tree, float factor, float min_length, float max_length, std::span<glm::vec4> velocities);
+
+// Double precision accelerations and potentials, -G sum m_j / r_ij, with the pair softening of
+// compute_potential.glsl. Softening lengths in the w lane of the velocities, 0 for softening.
+void accumulate_softened_potentials(std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities, float gravity,
+                                    float softening, std::span<glm::dvec3> accelerations, std::span<double> potentials);
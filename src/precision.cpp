@@ -0,0 +1,215 @@
+#include "precision.hpp"
+#include "diagnostics.hpp"
+#include "gl_resources.hpp"
+#include "gravity.hpp"
+#include "scene.hpp"
+#include "shader.hpp"
+#include "simulation_parameters.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <vector>
+#include <glm/glm.hpp>
+
+static const std::filesystem::path COMPUTE_SHADER_FILEPATH = "../shaders/compute.glsl";
+static const std::filesystem::path RELATIVE_SHADER_FILEPATH = "../shaders/compute_relative.glsl";
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]]
+static GLuint num_groups(GLuint count)
+{
+    return (count + RelativeIntegrator::WORKGROUP_SIZE - 1) / RelativeIntegrator::WORKGROUP_SIZE;
+}
+
+RelativeIntegrator make_relative_integrator(std::size_t capacity)
+{
+    RelativeIntegrator integrator;
+    integrator.program.reset(make_compute_shader_program(RELATIVE_SHADER_FILEPATH));
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        integrator.cells[i] = make_buffer(static_cast<GLsizeiptr>(capacity * sizeof(glm::ivec4)), nullptr, 0);
+        integrator.offsets_and_masses[i] = make_buffer(static_cast<GLsizeiptr>(capacity * sizeof(glm::vec4)), nullptr, 0);
+    }
+    return integrator;
+}
+
+void reload_relative_program(RelativeIntegrator &integrator)
+{
+    integrator.program.reset(reload_compute_shader_program(integrator.program.release(), RELATIVE_SHADER_FILEPATH));
+}
+
+void split_positions(RelativeIntegrator &integrator, GLuint positions_and_masses, GLuint count)
+{
+    GLuint program = integrator.program.get();
+    glUseProgram(program);
+    glUniform1ui(glGetUniformLocation(program, "count"), count);
+    glUniform1ui(glGetUniformLocation(program, "stage"), 0);
+    glUniform1f(glGetUniformLocation(program, "cell_size"), Scene::PRECISION_CELL_SIZE);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_and_masses);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, integrator.cells[integrator.current].get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, integrator.offsets_and_masses[integrator.current].get());
+
+    glDispatchCompute(num_groups(count), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void step_relative(RelativeIntegrator &integrator, GLuint positions_and_masses_out, GLuint velocities, GLuint count,
+                   float dt, float gravity, float softening)
+{
+    std::size_t next = 1 - integrator.current;
+    GLuint program = integrator.program.get();
+
+    glUseProgram(program);
+    glUniform1ui(glGetUniformLocation(program, "count"), count);
+    glUniform1ui(glGetUniformLocation(program, "stage"), 1);
+    glUniform1f(glGetUniformLocation(program, "dt"), dt);
+    glUniform1f(glGetUniformLocation(program, "gravity"), gravity);
+    glUniform1f(glGetUniformLocation(program, "softening"), softening);
+    glUniform1f(glGetUniformLocation(program, "cell_size"), Scene::PRECISION_CELL_SIZE);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, positions_and_masses_out);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, integrator.cells[integrator.current].get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, integrator.offsets_and_masses[integrator.current].get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, integrator.cells[next].get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, integrator.offsets_and_masses[next].get());
+
+    glDispatchCompute(num_groups(count), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    integrator.current = next;
+}
+
+static void read_buffer(const Buffer &buffer, std::vector<glm::vec4> &values)
+{
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetNamedBufferSubData(buffer.get(), 0, static_cast<GLsizeiptr>(values.size() * sizeof(glm::vec4)), values.data());
+}
+
+static void write_buffer(const Buffer &buffer, const std::vector<glm::vec4> &values)
+{
+    glNamedBufferSubData(buffer.get(), 0, static_cast<GLsizeiptr>(values.size() * sizeof(glm::vec4)), values.data());
+}
+
+// Plain fp32 kernel, bindings of compute.glsl, its parameters are in the bound uniform ring
+static void step_plain(GLuint program, GLuint positions_in, GLuint positions_out, GLuint velocities, GLuint count)
+{
+    glUseProgram(program);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions_in);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, positions_out);
+
+    glDispatchCompute(num_groups(count), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Parameters of compute.glsl for one body count and time step
+static void update_plain_parameters(UniformRing &ring, GLuint count, float dt)
+{
+    SimulationParameters parameters;
+    parameters.count = count;
+    parameters.dt = dt;
+    parameters.gravity = Scene::GRAVITY;
+    parameters.softening = Scene::SOFTENING;
+    parameters.iter_per_frame = 1;
+    update_uniform_ring(ring, parameters);
+}
+
+std::optional<PrecisionReport> run_precision_comparison(std::size_t count, std::size_t steps)
+{
+    Program plain_program{make_compute_shader_program(COMPUTE_SHADER_FILEPATH)};
+    UniformRing plain_parameters = make_uniform_ring(sizeof(SimulationParameters), SIMULATION_PARAMETERS_BINDING);
+    RelativeIntegrator integrator = make_relative_integrator(count);
+    if (!plain_program || !integrator.program)
+    {
+        return std::nullopt;
+    }
+
+    Scene scene = create_sun_collapse(42, count);
+    GLuint gpu_count = static_cast<GLuint>(count);
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    std::array<Buffer, 2> positions = {make_buffer(size, nullptr, GL_DYNAMIC_STORAGE_BIT), make_buffer(size, nullptr, GL_DYNAMIC_STORAGE_BIT)};
+    Buffer velocities = make_buffer(size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    // Double precision reference for a single force evaluation
+    std::vector<glm::dvec3> reference(count, glm::dvec3(0.0));
+    accumulate_accelerations(scene.positions_and_masses, 0, scene.positions_and_masses, 0, Scene::GRAVITY, Scene::SOFTENING, reference);
+
+    auto run_mode = [&](bool relative)
+    {
+        PrecisionModeReport report;
+        std::vector<glm::vec4> values(count);
+
+        // From rest with dt = 1 the velocities written by one step are the accelerations
+        write_buffer(positions[0], scene.positions_and_masses);
+        write_buffer(velocities, std::vector<glm::vec4>(count, glm::vec4(0.0f)));
+        if (relative)
+        {
+            split_positions(integrator, positions[0].get(), gpu_count);
+            step_relative(integrator, positions[1].get(), velocities.get(), gpu_count, 1.0f, Scene::GRAVITY, Scene::SOFTENING);
+        }
+        else
+        {
+            update_plain_parameters(plain_parameters, gpu_count, 1.0f);
+            step_plain(plain_program.get(), positions[0].get(), positions[1].get(), velocities.get(), gpu_count);
+        }
+        read_buffer(velocities, values);
+
+        double sum_sq = 0.0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double error = glm::length(glm::dvec3(values[i]) - reference[i]) / std::max(glm::length(reference[i]), 1e-30);
+            report.max_acceleration_error = std::max(report.max_acceleration_error, error);
+            sum_sq += error * error;
+        }
+        report.rms_acceleration_error = std::sqrt(sum_sq / static_cast<double>(count));
+
+        // Energy drift and throughput over the run
+        write_buffer(positions[0], scene.positions_and_masses);
+        write_buffer(velocities, scene.velocities);
+        double initial_energy = compute_diagnostics(scene.positions_and_masses, scene.velocities, Scene::GRAVITY, Scene::SOFTENING).total_energy();
+
+        if (relative)
+        {
+            split_positions(integrator, positions[0].get(), gpu_count);
+        }
+        else
+        {
+            update_plain_parameters(plain_parameters, gpu_count, Scene::DT);
+        }
+        glFinish();
+        Clock::time_point start = Clock::now();
+
+        for (std::size_t step = 0; step < steps; ++step)
+        {
+            if (relative)
+            {
+                step_relative(integrator, positions[1].get(), velocities.get(), gpu_count, Scene::DT, Scene::GRAVITY, Scene::SOFTENING);
+            }
+            else
+            {
+                step_plain(plain_program.get(), positions[0].get(), positions[1].get(), velocities.get(), gpu_count);
+            }
+            std::swap(positions[0], positions[1]);
+        }
+
+        glFinish();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        report.steps_per_second = seconds > 0.0 ? static_cast<double>(steps) / seconds : 0.0;
+
+        std::vector<glm::vec4> final_velocities(count);
+        read_buffer(positions[0], values);
+        read_buffer(velocities, final_velocities);
+        double final_energy = compute_diagnostics(values, final_velocities, Scene::GRAVITY, Scene::SOFTENING).total_energy();
+        report.energy_drift = std::abs(final_energy - initial_energy) / std::abs(initial_energy);
+
+        return report;
+    };
+
+    PrecisionReport report;
+    report.plain = run_mode(false);
+    report.relative = run_mode(true);
+
+    return report;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include <array>
+#include <cstddef>
+#include <optional>
+
+// Cell-relative integration state: per body the integer cell and the fp32 offset in that cell,
+// double buffered like the positions
+struct RelativeIntegrator
+{
+    static constexpr GLuint WORKGROUP_SIZE = 128;
+
+    Program program;
+    std::array<Buffer, 2> cells;
+    std::array<Buffer, 2> offsets_and_masses;
+    std::size_t current = 0;
+};
+
+[[nodiscard]]
+RelativeIntegrator make_relative_integrator(std::size_t capacity);
+
+void reload_relative_program(RelativeIntegrator &integrator);
+
+// Rebuild cells and offsets from absolute positions, after the upload or a merge pass
+void split_positions(RelativeIntegrator &integrator, GLuint positions_and_masses, GLuint count);
+
+// One step, the absolute positions are written to positions_and_masses_out for the other passes
+void step_relative(RelativeIntegrator &integrator, GLuint positions_and_masses_out, GLuint velocities, GLuint count,
+                   float dt, float gravity, float softening);
+
+// Plain fp32 against cell-relative on the same scene
+struct PrecisionModeReport
+{
+    double max_acceleration_error = 0.0; // relative to a double precision direct sum
+    double rms_acceleration_error = 0.0;
+    double energy_drift = 0.0;           // |E_end - E_start| / |E_start|
+    double steps_per_second = 0.0;
+};
+
+struct PrecisionReport
+{
+    PrecisionModeReport plain;
+    PrecisionModeReport relative;
+};
+
+// Needs a current OpenGL context
+[[nodiscard]]
+std::optional<PrecisionReport> run_precision_comparison(std::size_t count, std::size_t steps);
@@ -13,8 +13,7 @@ static float hash(uint32_t seed)
     return static_cast<float>(word) / static_cast<float>(UINT32_MAX);
 }
 
-[[nodiscard]]
-static glm::vec4 star_color(uint32_t seed)
+glm::vec4 star_color(uint32_t seed)
 {
     float temperature = hash(seed) * 30000.0f + 3000.0f;
 
@@ -50,9 +49,9 @@ static glm::vec4 star_color(const glm::vec4 &pos)
     return glm::vec4(0.2f, 0.6f, 0.3f, 1.0f);
 }
 
-Scene create_galaxy_bh_scene(uint32_t seed)
+Scene create_galaxy_bh_scene(uint32_t seed, std::size_t count)
 {
-    Scene scene;
+    Scene scene(count);
 
     std::mt19937 rng(seed);
 
@@ -63,7 +62,7 @@ Scene create_galaxy_bh_scene(uint32_t seed)
     scene.positions_and_masses[0] = glm::vec4(0.0f, 0.0f, 0.0f, BLACK_HOLE_MASS);
     scene.velocities[0] = glm::vec4(0.0f);
 
-    for (std::size_t i = 1; i < Scene::COUNT; ++i)
+    for (std::size_t i = 1; i < count; ++i)
     {
         float m = masses(rng);
 
@@ -88,9 +87,9 @@ Scene create_galaxy_bh_scene(uint32_t seed)
     return scene;
 }
 
-Scene create_galaxy_scene(uint32_t seed)
+Scene create_galaxy_scene(uint32_t seed, std::size_t count)
 {
-    Scene scene;
+    Scene scene(count);
 
     std::mt19937 rng(seed);
 
@@ -98,7 +97,7 @@ Scene create_galaxy_scene(uint32_t seed)
     std::uniform_real_distribution<float> angle(ANGLE_MIN, ANGLE_MAX);
     std::uniform_real_distribution<float> radius(RADIUS_MIN, 0.25f * RADIUS_MAX);
 
-    for (std::size_t i = 0; i < Scene::COUNT; ++i)
+    for (std::size_t i = 0; i < count; ++i)
     {
         float m = masses(rng); //* 3.8e5;
 
@@ -123,9 +122,9 @@ Scene create_galaxy_scene(uint32_t seed)
     return scene;
 }
 
-Scene create_galaxy_collision_scene(uint32_t seed)
+Scene create_galaxy_collision_scene(uint32_t seed, std::size_t count)
 {
-    Scene scene;
+    Scene scene(count);
 
     std::mt19937 rng(seed);
 
@@ -141,7 +140,7 @@ Scene create_galaxy_collision_scene(uint32_t seed)
     scene.positions_and_masses[0] = glm::vec4(x_offset, 0.0f, 0.0f, BLACK_HOLE_MASS);
     scene.velocities[0] = glm::vec4(vx_offset, 0.0f, vz_offset, 0.0f);
 
-    for (std::size_t i = 1; i < Scene::COUNT / 2; ++i)
+    for (std::size_t i = 1; i < count / 2; ++i)
     {
         float m = masses(rng);
 
@@ -163,10 +162,10 @@ Scene create_galaxy_collision_scene(uint32_t seed)
     }
 
     // Second galaxy
-    scene.positions_and_masses[Scene::COUNT / 2] = glm::vec4(-x_offset, 0.0f, 0.0f, BLACK_HOLE_MASS);
-    scene.velocities[Scene::COUNT / 2] = glm::vec4(-vx_offset, 0.0f, -vz_offset, 0.0f);
+    scene.positions_and_masses[count / 2] = glm::vec4(-x_offset, 0.0f, 0.0f, BLACK_HOLE_MASS);
+    scene.velocities[count / 2] = glm::vec4(-vx_offset, 0.0f, -vz_offset, 0.0f);
 
-    for (std::size_t i = Scene::COUNT / 2 + 1; i < Scene::COUNT; ++i)
+    for (std::size_t i = count / 2 + 1; i < count; ++i)
     {
         float m = masses(rng);
 
@@ -190,9 +189,9 @@ Scene create_galaxy_collision_scene(uint32_t seed)
     return scene;
 }
 
-Scene create_spheric_inequal(uint32_t seed)
+Scene create_spheric_inequal(uint32_t seed, std::size_t count)
 {
-    Scene scene;
+    Scene scene(count);
 
     std::mt19937 rng(seed);
 
@@ -201,7 +200,7 @@ Scene create_spheric_inequal(uint32_t seed)
     std::uniform_real_distribution<float> colatitude(ANGLE_MIN, PI);
     std::uniform_real_distribution<float> radius(RADIUS_MIN, RADIUS_MIN);
 
-    for (std::size_t i = 0; i < Scene::COUNT; ++i)
+    for (std::size_t i = 0; i < count; ++i)
     {
         float m = 1.0f;
         float theta = longitude(rng);
@@ -228,9 +227,9 @@ Scene create_spheric_inequal(uint32_t seed)
     return scene;
 }
 
-Scene create_universe(uint32_t seed)
+Scene create_universe(uint32_t seed, std::size_t count)
 {
-    Scene scene;
+    Scene scene(count);
 
     std::mt19937 rng(seed);
 
@@ -240,7 +239,7 @@ Scene create_universe(uint32_t seed)
 
     std::uniform_real_distribution<float> normal(0.0f, 1.0f);
 
-    for (std::size_t i = 0; i < Scene::COUNT; ++i)
+    for (std::size_t i = 0; i < count; ++i)
     {
         float m = masses(rng);
         float r = radius(rng);
@@ -269,9 +268,9 @@ Scene create_universe(uint32_t seed)
     return scene;
 }
 
-Scene create_sun_collapse(uint32_t seed)
+Scene create_sun_collapse(uint32_t seed, std::size_t count)
 {
-    Scene scene;
+    Scene scene(count);
 
     std::mt19937 rng(seed);
 
@@ -289,7 +288,7 @@ Scene create_sun_collapse(uint32_t seed)
         glm::vec4(0.82f, 0.251f, 0.035f, 1.0f)
     };
 
-    for (std::size_t i = 0; i < Scene::COUNT; ++i)
+    for (std::size_t i = 0; i < count; ++i)
     {
         float m = MASS_MAX; //masses(rng);
         float r = RADIUS_MAX; //radius(rng);
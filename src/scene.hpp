@@ -17,40 +17,58 @@ struct Scene
     static constexpr float GRAVITY = 156000.f; // 1.0f;
     static constexpr std::size_t ITER_PER_FRAME = 1;
     static constexpr float SOFTENING = 156.0f;
+    static constexpr float ADAPTIVE_SOFTENING_FACTOR = 0.5f;         // softening length per mean spacing of the bodies around
+    static constexpr float ADAPTIVE_SOFTENING_MAX = 16.0f * SOFTENING; // SOFTENING is the shortest length
+    static constexpr std::size_t ADAPTIVE_SOFTENING_INTERVAL = 60;     // steps between two updates of the lengths
+    static constexpr float MERGE_RADIUS = 0.5f * SOFTENING;
+    static constexpr std::size_t MERGE_INTERVAL = 16; // steps between two merge passes
+    static constexpr std::size_t DIAGNOSTICS_INTERVAL = 60; // steps between two diagnostics when toggled on
+    static constexpr float HALO_LINKING_LENGTH = SOFTENING;
+    static constexpr std::size_t HALO_MIN_MEMBERS = 20;
+    static constexpr float PRECISION_CELL_SIZE = 1024.0f; // power of two, cell-relative precision mode
 
     std::vector<glm::vec4> positions_and_masses; // x, y, z, m
-    std::vector<glm::vec4> velocities;           // vx, vy, vz, 0
+    std::vector<glm::vec4> velocities;           // vx, vy, vz, softening length (0 for SOFTENING)
     std::vector<glm::vec4> colors;               // r, g, b, a
 
-    Scene()
-        : positions_and_masses(COUNT, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)),
-          velocities(COUNT, glm::vec4(0.0f)),
-          colors(COUNT, glm::vec4(1.0f))
+    explicit Scene(std::size_t count = COUNT)
+        : positions_and_masses(count, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)),
+          velocities(count, glm::vec4(0.0f)),
+          colors(count, glm::vec4(1.0f))
     {
     }
+
+    [[nodiscard]]
+    std::size_t count() const
+    {
+        return positions_and_masses.size();
+    }
 };
 
+// Star colour from a hash of seed, red to blue with temperature
+[[nodiscard]]
+glm::vec4 star_color(uint32_t seed);
 
 // Galaxy with black hole
 [[nodiscard]]
-Scene create_galaxy_bh_scene(uint32_t seed);
+Scene create_galaxy_bh_scene(uint32_t seed, std::size_t count = Scene::COUNT);
 
 // Galaxy no black hole
 [[nodiscard]]
-Scene create_galaxy_scene(uint32_t seed);
+Scene create_galaxy_scene(uint32_t seed, std::size_t count = Scene::COUNT);
 
 // Two galaxies colliding
 [[nodiscard]]
-Scene create_galaxy_collision_scene(uint32_t seed);
+Scene create_galaxy_collision_scene(uint32_t seed, std::size_t count = Scene::COUNT);
 
 // Spherical generation with bias
 [[nodiscard]]
-Scene create_spheric_inequal(uint32_t seed);
+Scene create_spheric_inequal(uint32_t seed, std::size_t count = Scene::COUNT);
 
 // Big bang effect
 [[nodiscard]]
-Scene create_universe(uint32_t seed);
+Scene create_universe(uint32_t seed, std::size_t count = Scene::COUNT);
 
 // Collapse effect
 [[nodiscard]]
-Scene create_sun_collapse(uint32_t seed);
\ No newline at end of file
+Scene create_sun_collapse(uint32_t seed, std::size_t count = Scene::COUNT);
\ No newline at end of file
@@ -0,0 +1,521 @@
+#include "scene_description.hpp"
+#include "error_log.hpp"
+#include "parallel.hpp"
+#include "scene.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+
+// Bodies generated by one task, each chunk has its own generator
+static constexpr std::size_t CHUNK_SIZE = 65536;
+
+std::size_t SceneDescription::count() const
+{
+    std::size_t total = 0;
+    for (const SceneComponent &component : components)
+    {
+        total += component.count;
+    }
+    return total;
+}
+
+[[nodiscard]]
+static std::string_view trim(std::string_view text)
+{
+    std::size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos)
+    {
+        return {};
+    }
+    std::size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Whitespace separated numbers, empty if one of them is not a number
+[[nodiscard]]
+static std::vector<float> parse_floats(std::string_view text)
+{
+    std::vector<float> values;
+    while (!(text = trim(text)).empty())
+    {
+        std::size_t end = std::min(text.find_first_of(" \t"), text.size());
+        float value = 0.0f;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + end, value);
+        if (ec != std::errc{} || ptr != text.data() + end)
+        {
+            return {};
+        }
+        values.push_back(value);
+        text.remove_prefix(end);
+    }
+    return values;
+}
+
+[[nodiscard]]
+static std::optional<ComponentType> component_type_from_string(std::string_view name)
+{
+    if (name == "disk")
+    {
+        return ComponentType::Disk;
+    }
+    if (name == "bulge")
+    {
+        return ComponentType::Bulge;
+    }
+    if (name == "black_hole")
+    {
+        return ComponentType::BlackHole;
+    }
+    if (name == "sphere")
+    {
+        return ComponentType::Sphere;
+    }
+    if (name == "plummer")
+    {
+        return ComponentType::Plummer;
+    }
+    return std::nullopt;
+}
+
+[[nodiscard]]
+static SceneComponent default_component(ComponentType type)
+{
+    SceneComponent component;
+    component.type = type;
+
+    if (type == ComponentType::BlackHole)
+    {
+        component.count = 1;
+        component.mass = glm::vec2(BLACK_HOLE_MASS);
+    }
+    else if (type == ComponentType::Bulge || type == ComponentType::Plummer)
+    {
+        component.radius = glm::vec2(RADIUS_MIN, 0.5f * RADIUS_MAX);
+    }
+
+    return component;
+}
+
+// Apply one "key = values" line to a component, the error message otherwise
+[[nodiscard]]
+static std::optional<std::string> apply_component_key(SceneComponent &component, std::string_view key, std::string_view text)
+{
+    std::vector<float> values = parse_floats(text);
+    auto expect = [&](std::size_t min_count, std::size_t max_count) -> std::optional<std::string>
+    {
+        if (values.size() < min_count || values.size() > max_count)
+        {
+            return std::format("'{}' expects {} to {} numbers", key, min_count, max_count);
+        }
+        return std::nullopt;
+    };
+
+    if (key == "count" && component.type != ComponentType::BlackHole)
+    {
+        std::string_view digits = trim(text);
+        auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), component.count);
+        if (ec != std::errc{} || ptr != digits.data() + digits.size())
+        {
+            return std::format("Invalid count '{}'", digits);
+        }
+        return std::nullopt;
+    }
+
+    if (key == "color")
+    {
+        std::string_view model = trim(text);
+        if (model == "temperature")
+        {
+            component.color_model = ColorModel::Temperature;
+        }
+        else if (model == "side")
+        {
+            component.color_model = ColorModel::Side;
+        }
+        else if (values.size() == 3 || values.size() == 4)
+        {
+            component.color_model = ColorModel::Constant;
+            component.color = glm::vec4(values[0], values[1], values[2], values.size() == 4 ? values[3] : 1.0f);
+        }
+        else
+        {
+            return "'color' expects temperature, side or 3 to 4 numbers";
+        }
+        return std::nullopt;
+    }
+
+    std::optional<std::string> error;
+    if (key == "offset" || key == "velocity" || key == "axis")
+    {
+        if (!(error = expect(3, 3)))
+        {
+            glm::vec3 value(values[0], values[1], values[2]);
+            (key == "offset" ? component.offset : key == "velocity" ? component.velocity : component.axis) = value;
+        }
+    }
+    else if (key == "mass" || key == "radius")
+    {
+        if (!(error = expect(1, 2)))
+        {
+            glm::vec2 value(values[0], values.size() == 2 ? values[1] : values[0]);
+            (key == "mass" ? component.mass : component.radius) = value;
+        }
+    }
+    else if (key == "thickness" || key == "central_mass" || key == "expansion")
+    {
+        if (!(error = expect(1, 1)))
+        {
+            (key == "thickness" ? component.thickness : key == "central_mass" ? component.central_mass : component.expansion) = values[0];
+        }
+    }
+    else
+    {
+        error = std::format("Unknown key '{}'", key);
+    }
+
+    return error;
+}
+
+[[nodiscard]]
+static std::optional<std::string> validate_component(const SceneComponent &component)
+{
+    if (component.count == 0)
+    {
+        return "Component without bodies";
+    }
+    if (component.mass.x <= 0.0f || component.mass.x > component.mass.y)
+    {
+        return "Masses must be positive and in increasing order";
+    }
+    if (component.radius.x <= 0.0f || component.radius.x > component.radius.y)
+    {
+        return "Radii must be positive and in increasing order";
+    }
+    if (glm::length(component.axis) == 0.0f)
+    {
+        return "Axis must not be zero";
+    }
+    return std::nullopt;
+}
+
+std::optional<SceneDescription> load_scene_description(const std::filesystem::path &filepath)
+{
+    std::ifstream file(filepath);
+    if (!file)
+    {
+        log_error(ErrorType::SceneDescription, std::format("Cannot open '{}'", filepath.string()));
+        return std::nullopt;
+    }
+
+    SceneDescription description;
+    bool scene_section = false;
+    std::size_t line_number = 0;
+    std::size_t section_line = 0;
+    auto report = [&](std::size_t line, std::string_view what)
+    {
+        log_error(ErrorType::SceneDescription, std::format("{}:{}: {}", filepath.string(), line, what));
+    };
+
+    // A component is complete once the next section starts
+    auto close_section = [&]()
+    {
+        if (scene_section || description.components.empty())
+        {
+            return true;
+        }
+        if (std::optional<std::string> error = validate_component(description.components.back()))
+        {
+            report(section_line, *error);
+            return false;
+        }
+        return true;
+    };
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        ++line_number;
+        std::string_view text = line;
+        text = trim(text.substr(0, text.find_first_of("#;")));
+        if (text.empty())
+        {
+            continue;
+        }
+
+        if (text.front() == '[')
+        {
+            if (text.back() != ']')
+            {
+                report(line_number, "Unterminated section");
+                return std::nullopt;
+            }
+            if (!close_section())
+            {
+                return std::nullopt;
+            }
+
+            std::string_view name = trim(text.substr(1, text.size() - 2));
+            section_line = line_number;
+            scene_section = name == "scene";
+            if (!scene_section)
+            {
+                std::optional<ComponentType> type = component_type_from_string(name);
+                if (!type)
+                {
+                    report(line_number, std::format("Unknown section '{}'", name));
+                    return std::nullopt;
+                }
+                description.components.push_back(default_component(*type));
+            }
+            continue;
+        }
+
+        std::size_t equal = text.find('=');
+        if (equal == std::string_view::npos)
+        {
+            report(line_number, "Expected 'key = value'");
+            return std::nullopt;
+        }
+        std::string_view key = trim(text.substr(0, equal));
+        std::string_view values = trim(text.substr(equal + 1));
+
+        if (scene_section)
+        {
+            auto [ptr, ec] = std::from_chars(values.data(), values.data() + values.size(), description.seed);
+            if (key != "seed" || ec != std::errc{} || ptr != values.data() + values.size())
+            {
+                report(line_number, std::format("Invalid scene key '{}'", key));
+                return std::nullopt;
+            }
+        }
+        else if (description.components.empty())
+        {
+            report(line_number, "Key outside of a section");
+            return std::nullopt;
+        }
+        else if (std::optional<std::string> error = apply_component_key(description.components.back(), key, values))
+        {
+            report(line_number, *error);
+            return std::nullopt;
+        }
+    }
+
+    if (!close_section())
+    {
+        return std::nullopt;
+    }
+    if (description.components.empty())
+    {
+        report(line_number, "No component");
+        return std::nullopt;
+    }
+
+    return description;
+}
+
+// Chunk of a component, [first, first + count) of the component, written from output_offset on
+struct SceneChunk
+{
+    std::size_t component = 0;
+    std::size_t first = 0;
+    std::size_t count = 0;
+    std::size_t output_offset = 0;
+};
+
+[[nodiscard]]
+static glm::vec3 random_direction(std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    float cos_phi = 1.0f - 2.0f * uniform(rng);
+    float sin_phi = std::sqrt(std::max(0.0f, 1.0f - cos_phi * cos_phi));
+    float theta = ANGLE_MAX * uniform(rng);
+    return glm::vec3(sin_phi * std::cos(theta), sin_phi * std::sin(theta), cos_phi);
+}
+
+[[nodiscard]]
+static float mean_mass(const SceneComponent &component)
+{
+    return 0.5f * (component.mass.x + component.mass.y);
+}
+
+struct Body
+{
+    glm::vec3 position{0.0f}; // relative to the component center
+    glm::vec3 velocity{0.0f}; // relative to the bulk velocity
+};
+
+[[nodiscard]]
+static Body generate_disk_body(const SceneComponent &component, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> angle(ANGLE_MIN, ANGLE_MAX);
+    std::uniform_real_distribution<float> radius(component.radius.x, component.radius.y);
+
+    // Plane basis, a disk around +y starts along +x like the galaxy scenes
+    glm::vec3 axis = glm::normalize(component.axis);
+    glm::vec3 helper = std::abs(axis.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 w = glm::normalize(glm::cross(helper, axis));
+    glm::vec3 u = glm::cross(axis, w);
+
+    float r = radius(rng);
+    float theta = angle(rng);
+    float height = component.thickness * radius(rng) * ((rng() % 2) ? 1.0f : -1.0f);
+    glm::vec3 radial = std::cos(theta) * u + std::sin(theta) * w;
+
+    // Circular orbit around the central mass and the disk inside the orbit, radii are uniform
+    float inside = (component.radius.y > component.radius.x) ? (r - component.radius.x) / (component.radius.y - component.radius.x) : 1.0f;
+    float enclosed = component.central_mass + inside * mean_mass(component) * static_cast<float>(component.count);
+    float v = std::sqrt(Scene::GRAVITY * enclosed / r);
+
+    return Body{r * radial + height * axis, v * glm::cross(radial, axis)};
+}
+
+[[nodiscard]]
+static Body generate_bulge_body(const SceneComponent &component, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    float a = component.radius.x;
+
+    // Hernquist profile M(r) ~ r^2 / (r + a)^2 by inversion, truncated at the outer radius
+    float r = 0.0f;
+    do
+    {
+        float s = std::sqrt(uniform(rng));
+        r = s < 1.0f ? a * s / (1.0f - s) : component.radius.y + 1.0f;
+    } while (r > component.radius.y || r <= 0.0f);
+
+    // Isotropic velocities, dispersion from the mass inside r
+    float fraction = (r / (r + a)) * (r / (r + a));
+    float truncation = (component.radius.y / (component.radius.y + a)) * (component.radius.y / (component.radius.y + a));
+    float enclosed = component.central_mass + fraction / truncation * mean_mass(component) * static_cast<float>(component.count);
+    std::normal_distribution<float> dispersion(0.0f, std::sqrt(Scene::GRAVITY * enclosed / (3.0f * r)));
+
+    return Body{r * random_direction(rng), glm::vec3(dispersion(rng), dispersion(rng), dispersion(rng))};
+}
+
+[[nodiscard]]
+static Body generate_sphere_body(const SceneComponent &component, std::mt19937 &rng)
+{
+    // Uniform in volume between the radii
+    float r0 = component.radius.x * component.radius.x * component.radius.x;
+    float r1 = component.radius.y * component.radius.y * component.radius.y;
+    std::uniform_real_distribution<float> volume(r0, r1);
+    float r = std::cbrt(r0 == r1 ? r0 : volume(rng));
+
+    glm::vec3 direction = random_direction(rng);
+    return Body{r * direction, component.expansion * direction};
+}
+
+[[nodiscard]]
+static Body generate_plummer_body(const SceneComponent &component, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    float a = component.radius.x;
+
+    // Radius by inversion of M(r) ~ r^3 / (r^2 + a^2)^(3/2), truncated at the outer radius
+    float r = 0.0f;
+    do
+    {
+        float m = uniform(rng);
+        r = m > 0.0f ? a / std::sqrt(std::pow(m, -2.0f / 3.0f) - 1.0f) : 0.0f;
+    } while (!(r > 0.0f && r <= component.radius.y));
+
+    // Speed as a fraction q of the escape speed, rejection sampling of q^2 (1 - q^2)^3.5 (Aarseth, Henon & Wielen 1974)
+    float q = 0.0f;
+    float g = 0.0f;
+    do
+    {
+        q = uniform(rng);
+        g = 0.1f * uniform(rng);
+    } while (g > q * q * std::pow(1.0f - q * q, 3.5f));
+
+    float total_mass = mean_mass(component) * static_cast<float>(component.count);
+    float escape_speed = std::sqrt(2.0f * Scene::GRAVITY * total_mass / a) * std::pow(1.0f + r * r / (a * a), -0.25f);
+
+    return Body{r * random_direction(rng), q * escape_speed * random_direction(rng)};
+}
+
+[[nodiscard]]
+static glm::vec4 body_color(const SceneComponent &component, const glm::vec3 &position, uint32_t seed, std::size_t index)
+{
+    switch (component.color_model)
+    {
+    case ColorModel::Temperature:
+        return star_color(static_cast<uint32_t>(index) * (seed + 1));
+    case ColorModel::Side:
+        return position.x < 0.0f ? glm::vec4(0.8f, 0.5f, 0.3f, 1.0f) : glm::vec4(0.2f, 0.6f, 0.3f, 1.0f);
+    case ColorModel::Constant:
+        return component.color;
+    }
+    return glm::vec4(1.0f);
+}
+
+static void generate_chunk(const SceneDescription &description, const SceneChunk &chunk, const SceneOutput &output)
+{
+    const SceneComponent &component = description.components[chunk.component];
+    std::seed_seq seeds{description.seed, static_cast<uint32_t>(chunk.component), static_cast<uint32_t>(chunk.first / CHUNK_SIZE)};
+    std::mt19937 rng(seeds);
+    std::uniform_real_distribution<float> masses(component.mass.x, component.mass.y);
+
+    for (std::size_t i = 0; i < chunk.count; ++i)
+    {
+        Body body;
+        switch (component.type)
+        {
+        case ComponentType::Disk:
+            body = generate_disk_body(component, rng);
+            break;
+        case ComponentType::Bulge:
+            body = generate_bulge_body(component, rng);
+            break;
+        case ComponentType::BlackHole:
+            break;
+        case ComponentType::Sphere:
+            body = generate_sphere_body(component, rng);
+            break;
+        case ComponentType::Plummer:
+            body = generate_plummer_body(component, rng);
+            break;
+        }
+
+        std::size_t index = chunk.output_offset + i;
+        glm::vec3 position = component.offset + body.position;
+        output.positions_and_masses[index] = glm::vec4(position, masses(rng));
+
+        if (!output.velocities.empty())
+        {
+            output.velocities[index] = glm::vec4(component.velocity + body.velocity, 0.0f);
+        }
+        if (!output.colors.empty())
+        {
+            output.colors[index] = body_color(component, position, description.seed, index);
+        }
+    }
+}
+
+void generate_scene(const SceneDescription &description, const SceneOutput &output)
+{
+    std::vector<SceneChunk> chunks;
+    std::size_t offset = 0;
+    for (std::size_t c = 0; c < description.components.size(); ++c)
+    {
+        std::size_t count = description.components[c].count;
+        for (std::size_t first = 0; first < count; first += CHUNK_SIZE)
+        {
+            chunks.push_back(SceneChunk{c, first, std::min(CHUNK_SIZE, count - first), offset + first});
+        }
+        offset += count;
+    }
+
+    parallel_for(chunks.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            generate_chunk(description, chunks[i], output);
+        }
+    });
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "constants.hpp"
+
+enum class ComponentType
+{
+    Disk,      // rotating thin disk, bodies on circular orbits
+    Bulge,     // Hernquist profile, isotropic velocities
+    BlackHole, // single body
+    Sphere,    // uniform density shell or ball, optional radial expansion
+    Plummer,   // Plummer sphere in equilibrium
+};
+
+enum class ColorModel
+{
+    Temperature, // star colour from a hash of the body index
+    Side,        // by the side of the x = 0 plane, like the galaxy scenes
+    Constant,
+};
+
+// One component of a scene, keys of its section in the scene file
+struct SceneComponent
+{
+    ComponentType type = ComponentType::Disk;
+    std::size_t count = 0;
+    glm::vec3 offset{0.0f};   // position of the center
+    glm::vec3 velocity{0.0f}; // bulk velocity
+
+    // Per body mass range, masses are drawn uniformly from it, both ends the mass for black_hole.
+    // The velocities of disk, bulge and plummer bodies assume count times the mean mass in total.
+    glm::vec2 mass{MASS_MIN, MASS_MAX};
+
+    // Inner and outer radius for disk and sphere, scale and truncation radius for bulge and plummer
+    glm::vec2 radius{RADIUS_MIN, RADIUS_MAX};
+
+    float thickness = GALAXY_THICKNESS; // disk height over radius
+    glm::vec3 axis{0.0f, 1.0f, 0.0f};   // disk rotation axis
+    float central_mass = 0.0f;          // mass at the center the disk and bulge orbit, besides their own
+    float expansion = 0.0f;             // sphere radial speed
+
+    ColorModel color_model = ColorModel::Temperature;
+    glm::vec4 color{1.0f};
+};
+
+struct SceneDescription
+{
+    uint32_t seed = 42;
+    std::vector<SceneComponent> components;
+
+    [[nodiscard]]
+    std::size_t count() const;
+};
+
+// INI-like file: a [scene] section with the seed, then one section per component, [disk], [bulge],
+// [black_hole], [sphere] or [plummer], each with "key = values" lines. Empty and logged on error.
+[[nodiscard]]
+std::optional<SceneDescription> load_scene_description(const std::filesystem::path &filepath);
+
+// Destination of the generated bodies, count() each. Velocities and colors may be left empty.
+struct SceneOutput
+{
+    std::span<glm::vec4> positions_and_masses;
+    std::span<glm::vec4> velocities;
+    std::span<glm::vec4> colors;
+};
+
+// Generate straight into the output, fixed size chunks in parallel. Every chunk seeds its own
+// generator, the result does not depend on the number of threads.
+void generate_scene(const SceneDescription &description, const SceneOutput &output);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glad/gl.h>
+
+// std140 SimulationParameters uniform block of compute.glsl and the batched step shaders
+struct SimulationParameters
+{
+    GLuint count = 0;
+    float dt = 0.0f;
+    float gravity = 0.0f;
+    float softening = 0.0f;
+    GLuint iter_per_frame = 1;
+    GLuint step_count = 1; // steps of a batch, see step_batch.hpp
+    GLuint padding[2] = {};
+};
+static_assert(sizeof(SimulationParameters) == 32);
+
+// Uniform buffer binding of the block
+static constexpr GLuint SIMULATION_PARAMETERS_BINDING = 0;
@@ -0,0 +1,61 @@
+#include "snapshot_readback.hpp"
+
+// Read back by the CPU, kept in client memory
+[[nodiscard]]
+static Buffer make_staging_buffer(std::size_t size)
+{
+    return make_buffer(static_cast<GLsizeiptr>(size), nullptr, GL_CLIENT_STORAGE_BIT);
+}
+
+SnapshotReadback make_snapshot_readback(std::size_t capacity)
+{
+    SnapshotReadback readback;
+    readback.positions_and_masses = make_staging_buffer(capacity * sizeof(glm::vec4));
+    readback.velocities = make_staging_buffer(capacity * sizeof(glm::vec4));
+    return readback;
+}
+
+bool request_snapshot(SnapshotReadback &readback, GLuint positions_and_masses, GLuint velocities, GLuint count, std::size_t step)
+{
+    if (readback.fence)
+    {
+        return false;
+    }
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(positions_and_masses, readback.positions_and_masses.get(), 0, 0, size);
+    glCopyNamedBufferSubData(velocities, readback.velocities.get(), 0, 0, size);
+
+    readback.fence = make_fence();
+    readback.count = count;
+    readback.step = step;
+    return true;
+}
+
+std::optional<Snapshot> poll_snapshot(SnapshotReadback &readback)
+{
+    if (!readback.fence)
+    {
+        return std::nullopt;
+    }
+
+    GLenum status = glClientWaitSync(readback.fence.get(), GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+        return std::nullopt;
+    }
+
+    readback.fence.reset();
+
+    Snapshot snapshot;
+    snapshot.step = readback.step;
+    snapshot.positions_and_masses.resize(readback.count);
+    snapshot.velocities.resize(readback.count);
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(readback.count * sizeof(glm::vec4));
+    glGetNamedBufferSubData(readback.positions_and_masses.get(), 0, size, snapshot.positions_and_masses.data());
+    glGetNamedBufferSubData(readback.velocities.get(), 0, size, snapshot.velocities.data());
+
+    return snapshot;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Copy of the simulation state on the CPU
+struct Snapshot
+{
+    std::size_t step = 0;
+    std::vector<glm::vec4> positions_and_masses;
+    std::vector<glm::vec4> velocities;
+};
+
+// Asynchronous readback of positions and velocities. The state is copied GPU side into
+// staging buffers and only fetched once a fence says the copy is done.
+struct SnapshotReadback
+{
+    Buffer positions_and_masses;
+    Buffer velocities;
+    Fence fence;
+    GLuint count = 0;
+    std::size_t step = 0;
+};
+
+[[nodiscard]]
+SnapshotReadback make_snapshot_readback(std::size_t capacity);
+
+// Queue a copy of the first count bodies, false if the previous one has not been collected yet
+bool request_snapshot(SnapshotReadback &readback, GLuint positions_and_masses, GLuint velocities, GLuint count, std::size_t step);
+
+// Finished snapshot if any, never waits for the GPU
+[[nodiscard]]
+std::optional<Snapshot> poll_snapshot(SnapshotReadback &readback);
@@ -0,0 +1,123 @@
+#include "splat_renderer.hpp"
+#include "shader.hpp"
+#include <filesystem>
+#include <utility>
+#include <glm/gtc/type_ptr.hpp>
+
+static const std::filesystem::path SPLAT_SHADER_FILEPATH = "../shaders/splat.glsl";
+static const std::filesystem::path RESOLVE_VERTEX_SHADER_FILEPATH = "../shaders/resolve_vertex.glsl";
+static const std::filesystem::path RESOLVE_FRAGMENT_SHADER_FILEPATH = "../shaders/resolve_fragment.glsl";
+
+SplatRenderer make_splat_renderer()
+{
+    SplatRenderer renderer;
+
+    renderer.splat_program.reset(make_compute_shader_program(SPLAT_SHADER_FILEPATH));
+    renderer.resolve_program.reset(make_shader_program(RESOLVE_VERTEX_SHADER_FILEPATH, RESOLVE_FRAGMENT_SHADER_FILEPATH));
+    renderer.vao = make_vertex_array();
+
+    for (std::size_t slot = 0; slot < 2; ++slot)
+    {
+        renderer.splat_queries[slot] = make_query(GL_TIME_ELAPSED);
+        renderer.resolve_queries[slot] = make_query(GL_TIME_ELAPSED);
+    }
+
+    return renderer;
+}
+
+void reload_splat_programs(SplatRenderer &renderer)
+{
+    renderer.splat_program.reset(reload_compute_shader_program(renderer.splat_program.release(), SPLAT_SHADER_FILEPATH));
+    renderer.resolve_program.reset(reload_shader_program(renderer.resolve_program.release(), RESOLVE_VERTEX_SHADER_FILEPATH, RESOLVE_FRAGMENT_SHADER_FILEPATH));
+}
+
+// Reallocate both accumulation buffers when the framebuffer size changes
+static void resize_accumulation(SplatRenderer &renderer, int width, int height)
+{
+    if (renderer.width == width && renderer.height == height)
+    {
+        return;
+    }
+
+    renderer.width = width;
+    renderer.height = height;
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4 * sizeof(GLuint);
+    for (Buffer *buffer : {&renderer.accumulation, &renderer.previous_accumulation})
+    {
+        *buffer = make_buffer(size, nullptr, 0);
+        glClearNamedBufferData(buffer->get(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+}
+
+// Read the timings of the previous frame if they are ready, never stalls
+static void read_timings(SplatRenderer &renderer, std::size_t slot)
+{
+    GLuint splat_available = 0;
+    GLuint resolve_available = 0;
+    glGetQueryObjectuiv(renderer.splat_queries[slot].get(), GL_QUERY_RESULT_AVAILABLE, &splat_available);
+    glGetQueryObjectuiv(renderer.resolve_queries[slot].get(), GL_QUERY_RESULT_AVAILABLE, &resolve_available);
+    if (!splat_available || !resolve_available)
+    {
+        return;
+    }
+
+    GLuint64 splat_ns = 0;
+    GLuint64 resolve_ns = 0;
+    glGetQueryObjectui64v(renderer.splat_queries[slot].get(), GL_QUERY_RESULT, &splat_ns);
+    glGetQueryObjectui64v(renderer.resolve_queries[slot].get(), GL_QUERY_RESULT, &resolve_ns);
+    renderer.splat_ms = static_cast<double>(splat_ns) * 1e-6;
+    renderer.resolve_ms = static_cast<double>(resolve_ns) * 1e-6;
+}
+
+void render_splats(SplatRenderer &renderer, GLuint positions, GLuint colors, GLuint count, const glm::mat4 &mvp, int width, int height)
+{
+    resize_accumulation(renderer, width, height);
+
+    std::size_t slot = renderer.frame % 2;
+    if (renderer.frame >= 2)
+    {
+        read_timings(renderer, slot);
+    }
+    ++renderer.frame;
+
+    // Last frame's accumulation becomes the density estimate
+    std::swap(renderer.accumulation, renderer.previous_accumulation);
+    glClearNamedBufferData(renderer.accumulation.get(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    // Splat
+    glBeginQuery(GL_TIME_ELAPSED, renderer.splat_queries[slot].get());
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, colors);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, renderer.accumulation.get());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, renderer.previous_accumulation.get());
+
+    GLuint splat_program = renderer.splat_program.get();
+    glUseProgram(splat_program);
+    glUniformMatrix4fv(glGetUniformLocation(splat_program, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
+    glUniform1ui(glGetUniformLocation(splat_program, "count"), count);
+    glUniform2ui(glGetUniformLocation(splat_program, "resolution"), width, height);
+    glUniform1i(glGetUniformLocation(splat_program, "density_lod"), renderer.density_lod);
+    glUniform1f(glGetUniformLocation(splat_program, "lod_threshold"), SplatRenderer::LOD_THRESHOLD);
+
+    glDispatchCompute((count + SplatRenderer::WORKGROUP_SIZE - 1) / SplatRenderer::WORKGROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // Resolve
+    glBeginQuery(GL_TIME_ELAPSED, renderer.resolve_queries[slot].get());
+
+    glDisable(GL_DEPTH_TEST);
+    GLuint resolve_program = renderer.resolve_program.get();
+    glUseProgram(resolve_program);
+    glUniform2ui(glGetUniformLocation(resolve_program, "resolution"), width, height);
+    glUniform1f(glGetUniformLocation(resolve_program, "exposure"), SplatRenderer::EXPOSURE);
+    glBindVertexArray(renderer.vao.get());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+
+    glEndQuery(GL_TIME_ELAPSED);
+}
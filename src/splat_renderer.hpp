@@ -0,0 +1,41 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include <array>
+#include <glm/glm.hpp>
+
+// Compute shader point rasteriser: atomic splats into an accumulation buffer, then a tonemap pass
+struct SplatRenderer
+{
+    static constexpr GLuint WORKGROUP_SIZE = 128;
+    static constexpr float LOD_THRESHOLD = 16.0f; // splats per pixel before thinning starts
+    static constexpr float EXPOSURE = 2.0f;
+
+    Program splat_program;
+    Program resolve_program;
+    VertexArray vao;
+
+    // r, g, b, count per pixel, the previous frame drives the density LOD
+    Buffer accumulation;
+    Buffer previous_accumulation;
+    int width = 0;
+    int height = 0;
+
+    bool density_lod = true;
+
+    // GPU timings, read back when their query slot comes around again
+    std::array<Query, 2> splat_queries;
+    std::array<Query, 2> resolve_queries;
+    std::size_t frame = 0;
+    double splat_ms = 0.0;
+    double resolve_ms = 0.0;
+};
+
+[[nodiscard]]
+SplatRenderer make_splat_renderer();
+
+// Reload splat and resolve programs from file
+void reload_splat_programs(SplatRenderer &renderer);
+
+// Splat count bodies and resolve them to the bound framebuffer
+void render_splats(SplatRenderer &renderer, GLuint positions, GLuint colors, GLuint count, const glm::mat4 &mvp, int width, int height);
@@ -0,0 +1,251 @@
+#include "step_batch.hpp"
+#include "error_log.hpp"
+#include "merging.hpp"
+#include "scene.hpp"
+#include "shader.hpp"
+#include "simulation_parameters.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <glm/glm.hpp>
+
+static const std::filesystem::path COMPUTE_SHADER_FILEPATH = "../shaders/compute.glsl";
+static const std::filesystem::path PERSISTENT_SHADER_FILEPATH = "../shaders/compute_persistent.glsl";
+
+static constexpr GLbitfield GRID_SYNC_FLAGS = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+static constexpr GLuint64 FENCE_TIMEOUT_NS = 1'000'000'000;
+
+// GridSync block of compute_persistent.glsl
+struct GridSync
+{
+    GLuint arrived = 0;
+    GLuint generation = 0;
+    GLuint failed = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+std::string_view step_mode_to_string(StepMode mode)
+{
+    switch (mode)
+    {
+    case StepMode::PerStep:
+        return "per-step";
+    case StepMode::Indirect:
+        return "indirect";
+    case StepMode::Persistent:
+        return "persistent";
+    }
+    return "unknown";
+}
+
+std::optional<StepMode> step_mode_from_string(std::string_view name)
+{
+    for (StepMode mode : {StepMode::PerStep, StepMode::Indirect, StepMode::Persistent})
+    {
+        if (name == step_mode_to_string(mode))
+        {
+            return mode;
+        }
+    }
+    return std::nullopt;
+}
+
+[[nodiscard]]
+static GLuint num_groups(GLuint count)
+{
+    return (count + StepBatcher::WORKGROUP_SIZE - 1) / StepBatcher::WORKGROUP_SIZE;
+}
+
+StepBatcher make_step_batcher(GLuint capacity, GLuint persistent_groups)
+{
+    StepBatcher batcher;
+    batcher.persistent_program.reset(make_compute_shader_program(PERSISTENT_SHADER_FILEPATH));
+
+    GridSync grid_sync;
+    batcher.grid_sync = make_buffer(sizeof(GridSync), &grid_sync, GRID_SYNC_FLAGS);
+    batcher.mapped_grid_sync = static_cast<GLuint *>(glMapNamedBufferRange(batcher.grid_sync.get(), 0, sizeof(GridSync), GRID_SYNC_FLAGS));
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(std::max(capacity, 1u) * sizeof(glm::vec4));
+    batcher.saved_positions_and_masses = make_buffer(size, nullptr, 0);
+    batcher.saved_velocities = make_buffer(size, nullptr, 0);
+    batcher.capacity = capacity;
+    batcher.persistent_groups = std::max(persistent_groups, 1u);
+    return batcher;
+}
+
+void reload_step_batcher_programs(StepBatcher &batcher)
+{
+    batcher.persistent_program.reset(reload_compute_shader_program(batcher.persistent_program.release(), PERSISTENT_SHADER_FILEPATH));
+}
+
+void queue_indirect_steps(GLuint compute_program, GLuint live_count, const BindingSets &binding_sets, std::size_t parity, std::size_t steps)
+{
+    // The group count comes from the last compaction, the host never reads it.
+    // The callers advance the parity by every step, none may be dropped.
+    assert(steps <= StepBatcher::MAX_STEPS);
+    glUseProgram(compute_program);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, live_count);
+    for (std::size_t k = 0; k < steps; ++k)
+    {
+        glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, binding_sets[(parity + k) % 2].data());
+        glDispatchComputeIndirect(0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+bool run_persistent_steps(StepBatcher &batcher, const BindingSets &binding_sets, std::size_t parity, GLuint count)
+{
+    // The kernel updates the velocities in place and writes both positions buffers
+    assert(count <= batcher.capacity);
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    GLuint positions_and_masses = binding_sets[parity][0];
+    GLuint velocities = binding_sets[parity][1];
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(positions_and_masses, batcher.saved_positions_and_masses.get(), 0, 0, size);
+    glCopyNamedBufferSubData(velocities, batcher.saved_velocities.get(), 0, 0, size);
+
+    glUseProgram(batcher.persistent_program.get());
+    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, binding_sets[parity].data());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, batcher.grid_sync.get());
+
+    GLuint groups = std::min(batcher.persistent_groups, num_groups(count));
+    glDispatchCompute(std::max(groups, 1u), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+    // The failed flag is only known once the dispatch is done, nothing may read the bodies before
+    Fence fence = make_fence();
+    GLenum status = glClientWaitSync(fence.get(), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+    while (status == GL_TIMEOUT_EXPIRED)
+    {
+        status = glClientWaitSync(fence.get(), 0, FENCE_TIMEOUT_NS);
+    }
+    if (status == GL_WAIT_FAILED)
+    {
+        log_error(ErrorType::Synchronization, "Waiting for the persistent kernel failed, finishing the queue instead");
+        glFinish();
+    }
+
+    GridSync *grid_sync = reinterpret_cast<GridSync *>(batcher.mapped_grid_sync);
+    if (grid_sync->failed == 0)
+    {
+        return true;
+    }
+
+    // No other persistent dispatch is queued, the barrier can be reset for the next one
+    *grid_sync = GridSync{};
+    glCopyNamedBufferSubData(batcher.saved_positions_and_masses.get(), positions_and_masses, 0, 0, size);
+    glCopyNamedBufferSubData(batcher.saved_velocities.get(), velocities, 0, 0, size);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    return false;
+}
+
+std::optional<std::vector<StepBenchmarkReport>> run_step_benchmark(const std::vector<std::size_t> &counts, std::size_t steps,
+                                                                   std::size_t batch_steps, GLuint persistent_groups)
+{
+    Program compute_program{make_compute_shader_program(COMPUTE_SHADER_FILEPATH)};
+    std::size_t capacity = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+    StepBatcher batcher = make_step_batcher(static_cast<GLuint>(capacity), persistent_groups);
+    if (!compute_program || !batcher.persistent_program)
+    {
+        return std::nullopt;
+    }
+
+    batch_steps = std::clamp<std::size_t>(batch_steps, 1, StepBatcher::MAX_STEPS);
+    UniformRing parameters_ring = make_uniform_ring(sizeof(SimulationParameters), SIMULATION_PARAMETERS_BINDING);
+    std::vector<StepBenchmarkReport> reports;
+
+    for (std::size_t count : counts)
+    {
+        Scene scene = create_sun_collapse(42, count);
+        GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+        GLuint gpu_count = static_cast<GLuint>(count);
+
+        StepBenchmarkReport report;
+        report.count = count;
+        std::vector<glm::vec4> reference;
+
+        for (StepMode mode : {StepMode::PerStep, StepMode::Indirect, StepMode::Persistent})
+        {
+            std::array<Buffer, 2> positions = {make_buffer(size, scene.positions_and_masses.data(), 0), make_buffer(size, nullptr, 0)};
+            Buffer velocities = make_buffer(size, scene.velocities.data(), 0);
+            Buffer colors = make_buffer(size, scene.colors.data(), 0);
+            BindingSets binding_sets = {{{positions[0].get(), velocities.get(), colors.get(), positions[1].get()},
+                                         {positions[1].get(), velocities.get(), colors.get(), positions[0].get()}}};
+            LiveCount live_count = make_live_count(gpu_count);
+            Buffer live_count_buffer = make_buffer(sizeof(LiveCount), &live_count, 0);
+
+            SimulationParameters parameters;
+            parameters.count = gpu_count;
+            parameters.dt = Scene::DT;
+            parameters.gravity = Scene::GRAVITY;
+            parameters.softening = Scene::SOFTENING;
+            parameters.iter_per_frame = 1;
+
+            std::size_t parity = 0;
+            bool barrier_failed = false;
+            glFinish();
+            Clock::time_point start = Clock::now();
+
+            std::size_t done = 0;
+            while (done < steps && !barrier_failed)
+            {
+                std::size_t batch = mode == StepMode::PerStep ? 1 : std::min(batch_steps, steps - done);
+                if (parameters.step_count != batch || done == 0)
+                {
+                    parameters.step_count = static_cast<GLuint>(batch);
+                    update_uniform_ring(parameters_ring, parameters);
+                }
+
+                switch (mode)
+                {
+                case StepMode::PerStep:
+                    glUseProgram(compute_program.get());
+                    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, binding_sets[parity].data());
+                    glDispatchCompute(num_groups(gpu_count), 1, 1);
+                    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+                    break;
+                case StepMode::Indirect:
+                    queue_indirect_steps(compute_program.get(), live_count_buffer.get(), binding_sets, parity, batch);
+                    break;
+                case StepMode::Persistent:
+                    if (!run_persistent_steps(batcher, binding_sets, parity, gpu_count))
+                    {
+                        barrier_failed = true;
+                        continue;
+                    }
+                    break;
+                }
+
+                parity = (parity + batch) % 2;
+                done += batch;
+            }
+
+            glFinish();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            std::vector<glm::vec4> values(count);
+            glGetNamedBufferSubData(positions[parity].get(), 0, size, values.data());
+
+            StepModeReport mode_report;
+            mode_report.mode = mode;
+            mode_report.barrier_failed = barrier_failed;
+            mode_report.steps_per_second = seconds > 0.0 ? static_cast<double>(done) / seconds : 0.0;
+            if (mode == StepMode::PerStep)
+            {
+                reference = values;
+            }
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                mode_report.max_deviation = std::max(mode_report.max_deviation, glm::length(glm::vec3(values[i]) - glm::vec3(reference[i])));
+            }
+            report.modes.push_back(mode_report);
+        }
+
+        reports.push_back(std::move(report));
+    }
+
+    return reports;
+}
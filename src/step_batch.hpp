@@ -0,0 +1,88 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// How the simulation steps of a frame are submitted
+enum class StepMode
+{
+    PerStep,    // one dispatch per step, the passes of every step run in between
+    Indirect,   // the steps of a batch queued back to back as indirect dispatches sized on the GPU
+    Persistent, // the steps of a batch run by one persistent-threads dispatch
+};
+
+[[nodiscard]]
+std::string_view step_mode_to_string(StepMode mode);
+
+[[nodiscard]]
+std::optional<StepMode> step_mode_from_string(std::string_view name);
+
+// Storage bindings 0-3 of compute.glsl: positions in, velocities, colors, positions out.
+// Index 0 reads the first positions buffer, index 1 the second one.
+using BindingSets = std::array<std::array<GLuint, 4>, 2>;
+
+// Several simulation steps per submission, for small body counts where the launch overhead of one
+// dispatch per step leaves the GPU idle.
+// The body count of the SimulationParameters block may be larger than the live count after a merge,
+// the slots past it are massless (see merging.hpp).
+struct StepBatcher
+{
+    static constexpr std::size_t MAX_STEPS = 64;
+    static constexpr GLuint WORKGROUP_SIZE = 128;
+
+    Program persistent_program;
+
+    // Grid barrier of the persistent kernel: arrived, generation and a failed flag set by a workgroup
+    // that waited too long for the others. Mapped to check and reset the flag.
+    Buffer grid_sync;
+    GLuint *mapped_grid_sync = nullptr;
+
+    // Positions and velocities a persistent batch started from, restored when it failed
+    Buffer saved_positions_and_masses;
+    Buffer saved_velocities;
+    GLuint capacity = 0;
+
+    // Upper bound on the persistent workgroups, all of them have to be resident at once
+    GLuint persistent_groups = 0;
+};
+
+// capacity is the largest body count of a persistent batch
+[[nodiscard]]
+StepBatcher make_step_batcher(GLuint capacity, GLuint persistent_groups);
+
+void reload_step_batcher_programs(StepBatcher &batcher);
+
+// Queue steps indirect dispatches of the compute program, ping-ponging from the given parity, at most MAX_STEPS.
+// live_count holds a LiveCount record, rewritten on the GPU by the merges: the workgroup count of each step
+// comes from the GPU, the step count from the host.
+void queue_indirect_steps(GLuint compute_program, GLuint live_count, const BindingSets &binding_sets, std::size_t parity, std::size_t steps);
+
+// Run the step count of the bound SimulationParameters block in a single dispatch and wait for it.
+// False if the kernel gave up on its grid barrier, the workgroups were not all resident: the bodies are
+// then back to where the batch started and its steps have to be run another way.
+[[nodiscard]]
+bool run_persistent_steps(StepBatcher &batcher, const BindingSets &binding_sets, std::size_t parity, GLuint count);
+
+// Throughput of the step modes at small body counts, batch_steps steps per submission
+struct StepModeReport
+{
+    StepMode mode = StepMode::PerStep;
+    double steps_per_second = 0.0;
+    float max_deviation = 0.0f; // largest position difference to the per step mode
+    bool barrier_failed = false; // persistent mode whose workgroups were not all resident
+};
+
+struct StepBenchmarkReport
+{
+    std::size_t count = 0;
+    std::vector<StepModeReport> modes;
+};
+
+// Needs a current OpenGL context
+[[nodiscard]]
+std::optional<std::vector<StepBenchmarkReport>> run_step_benchmark(const std::vector<std::size_t> &counts, std::size_t steps,
+                                                                   std::size_t batch_steps, GLuint persistent_groups);
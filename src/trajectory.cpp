@@ -0,0 +1,504 @@
+#include "trajectory.hpp"
+#include "error_log.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <format>
+
+static constexpr std::array<char, 4> TRAJECTORY_MAGIC = {'N', 'B', 'T', 'J'};
+static constexpr std::array<char, 4> INDEX_MAGIC = {'N', 'B', 'T', 'I'};
+static constexpr uint32_t TRAJECTORY_VERSION = 1;
+
+// x, y, z of the position then of the velocity
+static constexpr std::size_t CODES_PER_BODY = 6;
+
+// Codes stay exactly representable as float
+static constexpr int64_t MAX_CODE = int64_t{1} << 24;
+
+// Written as is
+static_assert(sizeof(TrajectoryGrid) == 12 * sizeof(float));
+static_assert(sizeof(TrajectoryFrameEntry) == 24);
+
+using Clock = std::chrono::steady_clock;
+
+template <typename T>
+static void write_value(std::ostream &output, const T &value)
+{
+    output.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static void write_values(std::ostream &output, std::span<const T> values)
+{
+    output.write(reinterpret_cast<const char *>(values.data()), values.size_bytes());
+}
+
+template <typename T>
+[[nodiscard]]
+static bool read_value(std::istream &input, T &value)
+{
+    return static_cast<bool>(input.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+template <typename T>
+[[nodiscard]]
+static bool read_values(std::istream &input, std::span<T> values)
+{
+    return static_cast<bool>(input.read(reinterpret_cast<char *>(values.data()), values.size_bytes()));
+}
+
+[[nodiscard]]
+static uint64_t zigzag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+[[nodiscard]]
+static int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void put_varint(std::vector<uint8_t> &bytes, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+[[nodiscard]]
+static uint64_t get_varint(const uint8_t *&cursor, const uint8_t *end)
+{
+    uint64_t value = 0;
+    for (int shift = 0; cursor < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+[[nodiscard]]
+static std::size_t num_blocks(std::size_t count)
+{
+    return (count + TRAJECTORY_BLOCK_SIZE - 1) / TRAJECTORY_BLOCK_SIZE;
+}
+
+// Value k of a body: position then velocity components
+[[nodiscard]]
+static float body_value(const glm::vec4 &position, const glm::vec4 &velocity, std::size_t k)
+{
+    return k < 3 ? position[k] : velocity[k - 3];
+}
+
+[[nodiscard]]
+static float grid_origin(const TrajectoryGrid &grid, std::size_t k)
+{
+    return k < 3 ? grid.position_origin[k] : grid.velocity_origin[k - 3];
+}
+
+[[nodiscard]]
+static float grid_step(const TrajectoryGrid &grid, std::size_t k)
+{
+    return k < 3 ? grid.position_step[k] : grid.velocity_step[k - 3];
+}
+
+[[nodiscard]]
+static TrajectoryGrid make_grid(std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities, uint32_t bits)
+{
+    glm::vec3 position_min(positions_and_masses[0]);
+    glm::vec3 position_max = position_min;
+    glm::vec3 velocity_min(velocities[0]);
+    glm::vec3 velocity_max = velocity_min;
+
+    for (std::size_t i = 1; i < positions_and_masses.size(); ++i)
+    {
+        position_min = glm::min(position_min, glm::vec3(positions_and_masses[i]));
+        position_max = glm::max(position_max, glm::vec3(positions_and_masses[i]));
+        velocity_min = glm::min(velocity_min, glm::vec3(velocities[i]));
+        velocity_max = glm::max(velocity_max, glm::vec3(velocities[i]));
+    }
+
+    // A flat axis (a disk in a plane, bodies at rest) still needs room to grow in the following frames
+    float levels = static_cast<float>((uint64_t{1} << bits) - 1);
+    auto step = [levels](glm::vec3 extent)
+    {
+        float floor = std::max({1.0f, extent.x / 256.0f, extent.y / 256.0f, extent.z / 256.0f});
+        return glm::max(extent, glm::vec3(floor)) / levels;
+    };
+
+    TrajectoryGrid grid;
+    grid.position_origin = position_min;
+    grid.position_step = step(position_max - position_min);
+    grid.velocity_origin = velocity_min;
+    grid.velocity_step = step(velocity_max - velocity_min);
+    return grid;
+}
+
+struct EncodedBlock
+{
+    std::vector<uint8_t> bytes;
+    float max_position_error = 0.0f;
+    float max_velocity_error = 0.0f;
+    bool fits = true; // every code below MAX_CODE
+};
+
+// Keyframe codes are updated in place for keyframes and read for other frames
+[[nodiscard]]
+static EncodedBlock encode_block(const TrajectoryGrid &grid, std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities,
+                                 std::span<int64_t> keyframe_codes, bool keyframe)
+{
+    EncodedBlock block;
+    block.bytes.reserve(positions_and_masses.size() * CODES_PER_BODY * 2);
+
+    for (std::size_t i = 0; i < positions_and_masses.size(); ++i)
+    {
+        for (std::size_t k = 0; k < CODES_PER_BODY; ++k)
+        {
+            float value = body_value(positions_and_masses[i], velocities[i], k);
+            float origin = grid_origin(grid, k);
+            float step = grid_step(grid, k);
+
+            int64_t code = std::llround((static_cast<double>(value) - origin) / step);
+            if (std::abs(code) >= MAX_CODE)
+            {
+                block.fits = false;
+                return block;
+            }
+
+            float error = std::abs(origin + static_cast<float>(code) * step - value);
+            float &max_error = k < 3 ? block.max_position_error : block.max_velocity_error;
+            max_error = std::max(max_error, error);
+
+            int64_t &keyframe_code = keyframe_codes[i * CODES_PER_BODY + k];
+            put_varint(block.bytes, zigzag(keyframe ? code : code - keyframe_code));
+            if (keyframe)
+            {
+                keyframe_code = code;
+            }
+        }
+    }
+
+    return block;
+}
+
+static void decode_block(const TrajectoryGrid &grid, const uint8_t *cursor, const uint8_t *end, std::span<int64_t> keyframe_codes, bool keyframe,
+                         std::span<glm::vec4> positions_and_masses, std::span<glm::vec4> velocities)
+{
+    for (std::size_t i = 0; i < positions_and_masses.size(); ++i)
+    {
+        for (std::size_t k = 0; k < CODES_PER_BODY; ++k)
+        {
+            int64_t &keyframe_code = keyframe_codes[i * CODES_PER_BODY + k];
+            int64_t code = unzigzag(get_varint(cursor, end));
+            if (keyframe)
+            {
+                keyframe_code = code;
+            }
+            else
+            {
+                code += keyframe_code;
+            }
+
+            float value = grid_origin(grid, k) + static_cast<float>(code) * grid_step(grid, k);
+            if (k < 3)
+            {
+                positions_and_masses[i][k] = value;
+            }
+            else
+            {
+                velocities[i][k - 3] = value;
+            }
+        }
+    }
+}
+
+TrajectoryWriter make_trajectory_writer(const std::filesystem::path &filepath, uint32_t bits, uint32_t keyframe_interval)
+{
+    TrajectoryWriter writer;
+    writer.bits = bits;
+    writer.keyframe_interval = std::max<uint32_t>(keyframe_interval, 1);
+
+    writer.output.open(filepath, std::ios::binary);
+    if (!writer.output)
+    {
+        log_error(ErrorType::Trajectory, std::format("Cannot open '{}'", filepath.string()));
+        return writer;
+    }
+
+    write_values<char>(writer.output, TRAJECTORY_MAGIC);
+    write_value(writer.output, TRAJECTORY_VERSION);
+    write_value(writer.output, writer.bits);
+    write_value(writer.output, writer.keyframe_interval);
+    write_value(writer.output, TRAJECTORY_BLOCK_SIZE);
+
+    return writer;
+}
+
+void write_trajectory_frame(TrajectoryWriter &writer, std::size_t step, std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities)
+{
+    Clock::time_point start = Clock::now();
+
+    std::size_t count = positions_and_masses.size();
+    std::size_t frame = writer.index.size();
+    std::size_t blocks = num_blocks(count);
+
+    bool keyframe = writer.index.empty() || count != writer.index.back().count || frame - writer.index.back().keyframe >= writer.keyframe_interval;
+
+    std::vector<EncodedBlock> encoded(blocks);
+    auto encode = [&]()
+    {
+        if (keyframe)
+        {
+            writer.grids.resize(blocks);
+            writer.keyframe_codes.assign(count * CODES_PER_BODY, 0);
+        }
+
+        bool fits = true;
+        parallel_for(blocks, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t b = begin; b < end; ++b)
+            {
+                std::size_t first = b * TRAJECTORY_BLOCK_SIZE;
+                std::size_t size = std::min<std::size_t>(TRAJECTORY_BLOCK_SIZE, count - first);
+                std::span block_positions = positions_and_masses.subspan(first, size);
+                std::span block_velocities = velocities.subspan(first, size);
+
+                if (keyframe)
+                {
+                    writer.grids[b] = make_grid(block_positions, block_velocities, writer.bits);
+                }
+
+                std::span block_codes(writer.keyframe_codes.data() + first * CODES_PER_BODY, size * CODES_PER_BODY);
+                encoded[b] = encode_block(writer.grids[b], block_positions, block_velocities, block_codes, keyframe);
+            }
+        });
+
+        for (const EncodedBlock &block : encoded)
+        {
+            fits = fits && block.fits;
+        }
+        return fits;
+    };
+
+    // Bodies drifted too far from the keyframe grid, start a new keyframe
+    if (!encode())
+    {
+        keyframe = true;
+        [[maybe_unused]] bool fits = encode();
+        assert(fits);
+    }
+
+    TrajectoryFrameEntry entry;
+    entry.offset = static_cast<uint64_t>(writer.output.tellp());
+    entry.step = step;
+    entry.count = static_cast<uint32_t>(count);
+    entry.keyframe = static_cast<uint32_t>(keyframe ? frame : writer.index.back().keyframe);
+
+    if (keyframe)
+    {
+        std::vector<float> masses(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            masses[i] = positions_and_masses[i].w;
+        }
+        write_values<TrajectoryGrid>(writer.output, writer.grids);
+        write_values<float>(writer.output, masses);
+    }
+
+    std::vector<uint32_t> block_sizes;
+    block_sizes.reserve(blocks);
+    for (const EncodedBlock &block : encoded)
+    {
+        block_sizes.push_back(static_cast<uint32_t>(block.bytes.size()));
+        writer.max_position_error = std::max(writer.max_position_error, block.max_position_error);
+        writer.max_velocity_error = std::max(writer.max_velocity_error, block.max_velocity_error);
+    }
+    write_values<uint32_t>(writer.output, block_sizes);
+    for (const EncodedBlock &block : encoded)
+    {
+        write_values<uint8_t>(writer.output, block.bytes);
+    }
+
+    writer.index.push_back(entry);
+    writer.raw_bytes += count * (sizeof(glm::vec4) + sizeof(glm::vec4));
+    writer.encoded_bytes = static_cast<std::size_t>(writer.output.tellp());
+    writer.encode_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool finish_trajectory(TrajectoryWriter &writer)
+{
+    uint64_t index_offset = static_cast<uint64_t>(writer.output.tellp());
+    uint64_t frames = writer.index.size();
+
+    write_values<TrajectoryFrameEntry>(writer.output, writer.index);
+    write_value(writer.output, index_offset);
+    write_value(writer.output, frames);
+    write_values<char>(writer.output, INDEX_MAGIC);
+
+    writer.encoded_bytes = static_cast<std::size_t>(writer.output.tellp());
+    writer.output.close();
+    return !writer.output.fail();
+}
+
+double compression_ratio(const TrajectoryWriter &writer)
+{
+    if (writer.encoded_bytes == 0)
+    {
+        return 0.0;
+    }
+    return static_cast<double>(writer.raw_bytes) / static_cast<double>(writer.encoded_bytes);
+}
+
+std::optional<TrajectoryReader> open_trajectory(const std::filesystem::path &filepath)
+{
+    TrajectoryReader reader;
+    reader.input.open(filepath, std::ios::binary);
+    if (!reader.input)
+    {
+        log_error(ErrorType::Trajectory, std::format("Cannot open '{}'", filepath.string()));
+        return std::nullopt;
+    }
+
+    std::array<char, 4> magic{};
+    uint32_t version = 0;
+    uint32_t block_size = 0;
+    if (!read_values<char>(reader.input, magic) || magic != TRAJECTORY_MAGIC || !read_value(reader.input, version) || version != TRAJECTORY_VERSION ||
+        !read_value(reader.input, reader.bits) || !read_value(reader.input, reader.keyframe_interval) ||
+        !read_value(reader.input, block_size) || block_size != TRAJECTORY_BLOCK_SIZE)
+    {
+        log_error(ErrorType::Trajectory, std::format("'{}' is not a trajectory file", filepath.string()));
+        return std::nullopt;
+    }
+
+    uint64_t index_offset = 0;
+    uint64_t frames = 0;
+    std::array<char, 4> index_magic{};
+    reader.input.seekg(-static_cast<std::streamoff>(2 * sizeof(uint64_t) + INDEX_MAGIC.size()), std::ios::end);
+    if (!read_value(reader.input, index_offset) || !read_value(reader.input, frames) || !read_values<char>(reader.input, index_magic) || index_magic != INDEX_MAGIC)
+    {
+        log_error(ErrorType::Trajectory, std::format("'{}' has no index, the recording was interrupted", filepath.string()));
+        return std::nullopt;
+    }
+
+    reader.index.resize(frames);
+    reader.input.seekg(static_cast<std::streamoff>(index_offset));
+    if (!read_values<TrajectoryFrameEntry>(reader.input, reader.index))
+    {
+        log_error(ErrorType::Trajectory, std::format("'{}' has a truncated index", filepath.string()));
+        return std::nullopt;
+    }
+
+    return reader;
+}
+
+// Block sizes then payload of a frame, the stream is positioned after the keyframe data if any
+[[nodiscard]]
+static bool read_blocks(std::istream &input, std::size_t blocks, std::vector<uint32_t> &block_sizes, std::vector<uint8_t> &payload)
+{
+    block_sizes.resize(blocks);
+    if (!read_values<uint32_t>(input, block_sizes))
+    {
+        return false;
+    }
+
+    std::size_t payload_size = 0;
+    for (uint32_t size : block_sizes)
+    {
+        payload_size += size;
+    }
+    payload.resize(payload_size);
+    return read_values<uint8_t>(input, payload);
+}
+
+static void decode_frame(TrajectoryReader &reader, std::size_t count, const std::vector<uint32_t> &block_sizes, const std::vector<uint8_t> &payload,
+                         bool keyframe, std::vector<glm::vec4> &positions_and_masses, std::vector<glm::vec4> &velocities)
+{
+    std::vector<std::size_t> block_offsets(block_sizes.size() + 1, 0);
+    for (std::size_t b = 0; b < block_sizes.size(); ++b)
+    {
+        block_offsets[b + 1] = block_offsets[b] + block_sizes[b];
+    }
+
+    parallel_for(block_sizes.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t b = begin; b < end; ++b)
+        {
+            std::size_t first = b * TRAJECTORY_BLOCK_SIZE;
+            std::size_t size = std::min<std::size_t>(TRAJECTORY_BLOCK_SIZE, count - first);
+            std::span block_codes(reader.keyframe_codes.data() + first * CODES_PER_BODY, size * CODES_PER_BODY);
+
+            decode_block(reader.grids[b], payload.data() + block_offsets[b], payload.data() + block_offsets[b + 1], block_codes, keyframe,
+                         std::span(positions_and_masses).subspan(first, size), std::span(velocities).subspan(first, size));
+        }
+    });
+}
+
+bool read_trajectory_frame(TrajectoryReader &reader, std::size_t frame, std::vector<glm::vec4> &positions_and_masses, std::vector<glm::vec4> &velocities)
+{
+    if (frame >= reader.index.size())
+    {
+        return false;
+    }
+
+    const TrajectoryFrameEntry &entry = reader.index[frame];
+    std::size_t count = entry.count;
+    std::size_t blocks = num_blocks(count);
+
+    positions_and_masses.resize(count);
+    velocities.resize(count);
+
+    std::vector<uint32_t> block_sizes;
+    std::vector<uint8_t> payload;
+
+    if (reader.keyframe != entry.keyframe || frame == entry.keyframe)
+    {
+        reader.input.clear();
+        reader.input.seekg(static_cast<std::streamoff>(reader.index[entry.keyframe].offset));
+
+        reader.grids.resize(blocks);
+        reader.masses.resize(count);
+        reader.keyframe_codes.assign(count * CODES_PER_BODY, 0);
+        if (!read_values<TrajectoryGrid>(reader.input, reader.grids) || !read_values<float>(reader.input, reader.masses) ||
+            !read_blocks(reader.input, blocks, block_sizes, payload))
+        {
+            reader.keyframe.reset();
+            log_error(ErrorType::Trajectory, std::format("Truncated keyframe {}", entry.keyframe));
+            return false;
+        }
+
+        decode_frame(reader, count, block_sizes, payload, true, positions_and_masses, velocities);
+        reader.keyframe = entry.keyframe;
+    }
+
+    if (frame != entry.keyframe)
+    {
+        reader.input.clear();
+        reader.input.seekg(static_cast<std::streamoff>(entry.offset));
+        if (!read_blocks(reader.input, blocks, block_sizes, payload))
+        {
+            log_error(ErrorType::Trajectory, std::format("Truncated frame {}", frame));
+            return false;
+        }
+
+        decode_frame(reader, count, block_sizes, payload, false, positions_and_masses, velocities);
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        positions_and_masses[i].w = reader.masses[i];
+        velocities[i].w = 0.0f;
+    }
+
+    return true;
+}
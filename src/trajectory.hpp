@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+Compressed trajectory file.
+- Bodies are cut in blocks of TRAJECTORY_BLOCK_SIZE, each block coded independently and in parallel
+- Keyframes store a quantisation grid per block (origin and step from the bounding box of the block,
+  2^bits - 1 steps across), the masses, and the quantised positions and velocities
+- Other frames store the difference with the codes of their keyframe, on the keyframe grid,
+  so any frame decodes from its keyframe alone
+- Integers are zigzag then varint coded
+- An index at the end of the file gives random access to every frame
+The error is at most half a grid step per component.
+*/
+
+static constexpr uint32_t TRAJECTORY_BLOCK_SIZE = 4096;
+
+// Quantisation grid of one block, value = origin + code * step
+struct TrajectoryGrid
+{
+    glm::vec3 position_origin{0.0f};
+    glm::vec3 position_step{1.0f};
+    glm::vec3 velocity_origin{0.0f};
+    glm::vec3 velocity_step{1.0f};
+};
+
+struct TrajectoryFrameEntry
+{
+    uint64_t offset = 0;
+    uint64_t step = 0;
+    uint32_t count = 0;
+    uint32_t keyframe = 0; // index of the keyframe this frame is coded against, itself for keyframes
+};
+
+struct TrajectoryWriter
+{
+    std::ofstream output;
+    uint32_t bits = 16;
+    uint32_t keyframe_interval = 32;
+    std::vector<TrajectoryFrameEntry> index;
+
+    // Current keyframe, 6 codes per body
+    std::vector<TrajectoryGrid> grids;
+    std::vector<int64_t> keyframe_codes;
+
+    // Statistics
+    std::size_t raw_bytes = 0;
+    std::size_t encoded_bytes = 0;
+    float max_position_error = 0.0f;
+    float max_velocity_error = 0.0f;
+    double encode_seconds = 0.0;
+};
+
+struct TrajectoryReader
+{
+    std::ifstream input;
+    uint32_t bits = 0;
+    uint32_t keyframe_interval = 0;
+    std::vector<TrajectoryFrameEntry> index;
+
+    // Last decoded keyframe
+    std::optional<std::size_t> keyframe;
+    std::vector<TrajectoryGrid> grids;
+    std::vector<int64_t> keyframe_codes;
+    std::vector<float> masses;
+};
+
+// The output stream is not open on failure
+[[nodiscard]]
+TrajectoryWriter make_trajectory_writer(const std::filesystem::path &filepath, uint32_t bits, uint32_t keyframe_interval);
+
+// Append a frame, a keyframe every keyframe_interval frames or when the body count changes
+void write_trajectory_frame(TrajectoryWriter &writer, std::size_t step, std::span<const glm::vec4> positions_and_masses, std::span<const glm::vec4> velocities);
+
+// Write the index, the file is unreadable without it
+[[nodiscard]]
+bool finish_trajectory(TrajectoryWriter &writer);
+
+[[nodiscard]]
+double compression_ratio(const TrajectoryWriter &writer);
+
+[[nodiscard]]
+std::optional<TrajectoryReader> open_trajectory(const std::filesystem::path &filepath);
+
+// Decode any frame, only its keyframe is read as well (and cached)
+[[nodiscard]]
+bool read_trajectory_frame(TrajectoryReader &reader, std::size_t frame, std::vector<glm::vec4> &positions_and_masses, std::vector<glm::vec4> &velocities);
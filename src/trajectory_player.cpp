@@ -0,0 +1,185 @@
+#include "trajectory_player.hpp"
+#include "error_log.hpp"
+#include "scene.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+
+static constexpr GLbitfield UPLOAD_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+static constexpr GLuint64 FENCE_TIMEOUT_NS = 1'000'000'000;
+
+std::optional<TrajectoryPlayer> make_trajectory_player(const std::filesystem::path &filepath)
+{
+    std::optional<TrajectoryReader> reader = open_trajectory(filepath);
+    if (!reader)
+    {
+        return std::nullopt;
+    }
+
+    if (reader->index.empty())
+    {
+        log_error(ErrorType::Trajectory, std::format("'{}' has no frame", filepath.string()));
+        return std::nullopt;
+    }
+
+    std::optional<TrajectoryPlayer> player{std::in_place};
+    player->reader = std::move(*reader);
+    for (const TrajectoryFrameEntry &entry : player->reader.index)
+    {
+        player->capacity = std::max<std::size_t>(player->capacity, entry.count);
+    }
+    player->step = static_cast<double>(player->reader.index.front().step);
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(TrajectoryPlayer::RING_SIZE * player->capacity * sizeof(glm::vec4));
+    player->upload_buffer = make_buffer(size, nullptr, UPLOAD_FLAGS);
+    player->mapped = static_cast<glm::vec4 *>(glMapNamedBufferRange(player->upload_buffer.get(), 0, size, UPLOAD_FLAGS));
+
+    if (!player->mapped)
+    {
+        log_error(ErrorType::Trajectory, "Cannot map the upload ring");
+        return std::nullopt;
+    }
+
+    return player;
+}
+
+std::size_t frame_count(const TrajectoryPlayer &player)
+{
+    return player.reader.index.size();
+}
+
+std::size_t current_frame(const TrajectoryPlayer &player)
+{
+    const std::vector<TrajectoryFrameEntry> &index = player.reader.index;
+    auto after = std::upper_bound(index.begin(), index.end(), player.step,
+                                  [](double step, const TrajectoryFrameEntry &entry) { return step < static_cast<double>(entry.step); });
+    return after == index.begin() ? 0 : static_cast<std::size_t>(after - index.begin()) - 1;
+}
+
+void seek_trajectory(TrajectoryPlayer &player, std::size_t frame)
+{
+    frame = std::min(frame, frame_count(player) - 1);
+    player.step = static_cast<double>(player.reader.index[frame].step);
+}
+
+void scrub_trajectory(TrajectoryPlayer &player, double fraction)
+{
+    double first = static_cast<double>(player.reader.index.front().step);
+    double last = static_cast<double>(player.reader.index.back().step);
+    player.step = first + std::clamp(fraction, 0.0, 1.0) * (last - first);
+}
+
+void advance_playback(TrajectoryPlayer &player, double seconds)
+{
+    double last = static_cast<double>(player.reader.index.back().step);
+    player.step = std::min(player.step + player.speed * seconds / Scene::DT, last);
+}
+
+[[nodiscard]]
+static bool is_ready(const std::future<DecodedFrame> &future)
+{
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// Keep the decoded window on [target, target + READ_AHEAD), decoding the first missing frame
+static void read_ahead(TrajectoryPlayer &player, std::size_t target)
+{
+    std::size_t window_end = std::min(target + TrajectoryPlayer::READ_AHEAD, frame_count(player));
+    auto in_window = [&](std::size_t frame)
+    {
+        return frame >= target && frame < window_end;
+    };
+
+    if (player.pending.valid())
+    {
+        if (!is_ready(player.pending))
+        {
+            return;
+        }
+
+        DecodedFrame frame = player.pending.get();
+        if (in_window(frame.frame))
+        {
+            auto position = std::upper_bound(player.decoded.begin(), player.decoded.end(), frame.frame,
+                                             [](std::size_t f, const DecodedFrame &decoded) { return f < decoded.frame; });
+            player.decoded.insert(position, std::move(frame));
+        }
+    }
+
+    std::erase_if(player.decoded, [&](const DecodedFrame &decoded) { return !in_window(decoded.frame); });
+
+    for (std::size_t frame = target; frame < window_end; ++frame)
+    {
+        bool decoded = std::any_of(player.decoded.begin(), player.decoded.end(), [frame](const DecodedFrame &d) { return d.frame == frame; });
+        if (!decoded)
+        {
+            player.pending = std::async(std::launch::async, [&reader = player.reader, frame]()
+            {
+                DecodedFrame decoded_frame;
+                decoded_frame.frame = frame;
+                std::vector<glm::vec4> velocities;
+                if (!read_trajectory_frame(reader, frame, decoded_frame.positions_and_masses, velocities))
+                {
+                    decoded_frame.positions_and_masses.clear();
+                }
+                return decoded_frame;
+            });
+            return;
+        }
+    }
+}
+
+static void upload_frame(TrajectoryPlayer &player, const DecodedFrame &frame, GLuint positions_and_masses)
+{
+    std::size_t slot = player.upload_slot;
+    player.upload_slot = (slot + 1) % TrajectoryPlayer::RING_SIZE;
+
+    // The copy that last read this slot has to be done before it is overwritten
+    Fence &fence = player.fences[slot];
+    if (fence)
+    {
+        GLenum status = glClientWaitSync(fence.get(), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        while (status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(fence.get(), 0, FENCE_TIMEOUT_NS);
+        }
+        if (status == GL_WAIT_FAILED)
+        {
+            log_error(ErrorType::Synchronization, "Waiting for a trajectory upload slot failed, finishing the queue instead");
+            glFinish();
+        }
+        fence.reset();
+    }
+
+    std::size_t offset = slot * player.capacity;
+    std::size_t size = frame.positions_and_masses.size() * sizeof(glm::vec4);
+    std::memcpy(player.mapped + offset, frame.positions_and_masses.data(), size);
+
+    glCopyNamedBufferSubData(player.upload_buffer.get(), positions_and_masses, static_cast<GLintptr>(offset * sizeof(glm::vec4)), 0,
+                             static_cast<GLsizeiptr>(size));
+
+    fence = make_fence();
+}
+
+bool update_trajectory_player(TrajectoryPlayer &player, GLuint positions_and_masses)
+{
+    std::size_t target = current_frame(player);
+    read_ahead(player, target);
+
+    if (player.shown_frame == target || player.decoded.empty() || player.decoded.front().frame != target)
+    {
+        return false;
+    }
+
+    // A frame that failed to decode is skipped, the previous one stays on screen
+    const DecodedFrame &frame = player.decoded.front();
+    if (!frame.positions_and_masses.empty())
+    {
+        upload_frame(player, frame, positions_and_masses);
+        player.shown_count = static_cast<GLuint>(frame.positions_and_masses.size());
+    }
+    player.shown_frame = target;
+
+    return !frame.positions_and_masses.empty();
+}
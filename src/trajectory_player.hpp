@@ -0,0 +1,65 @@
+#pragma once
+
+#include "gl_resources.hpp"
+#include "trajectory.hpp"
+#include <array>
+#include <deque>
+#include <future>
+
+struct DecodedFrame
+{
+    std::size_t frame = 0;
+    std::vector<glm::vec4> positions_and_masses;
+};
+
+// Playback of a recorded trajectory instead of simulating. Frames ahead of the playback position
+// are decoded on a worker thread, written into a persistently mapped upload ring and copied into
+// the positions buffer on the GPU.
+// The worker reads through the reader member, the player must not move once playback started. It is
+// joined when pending is destroyed, before the reader.
+struct TrajectoryPlayer
+{
+    static constexpr std::size_t RING_SIZE = 3;
+    static constexpr std::size_t READ_AHEAD = 4;
+
+    TrajectoryReader reader;
+    std::size_t capacity = 0; // largest body count of the recording
+
+    // Upload ring, RING_SIZE slots of capacity bodies
+    Buffer upload_buffer;
+    glm::vec4 *mapped = nullptr;
+    std::array<Fence, RING_SIZE> fences;
+    std::size_t upload_slot = 0;
+
+    // Read-ahead window [frame shown, frame shown + READ_AHEAD), one frame decoded at a time
+    std::deque<DecodedFrame> decoded;
+    std::future<DecodedFrame> pending;
+
+    double step = 0.0;  // playback position, in simulation steps
+    double speed = 1.0; // simulation steps per Scene::DT of wall time
+    std::optional<std::size_t> shown_frame;
+    GLuint shown_count = 0;
+};
+
+[[nodiscard]]
+std::optional<TrajectoryPlayer> make_trajectory_player(const std::filesystem::path &filepath);
+
+[[nodiscard]]
+std::size_t frame_count(const TrajectoryPlayer &player);
+
+// Last frame recorded at or before the playback position
+[[nodiscard]]
+std::size_t current_frame(const TrajectoryPlayer &player);
+
+// Move the playback position to a frame, clamped to the recording
+void seek_trajectory(TrajectoryPlayer &player, std::size_t frame);
+
+// Move the playback position to a fraction of the recording, for scrubbing
+void scrub_trajectory(TrajectoryPlayer &player, double fraction);
+
+// Advance the playback position by wall clock time, stops at the last frame
+void advance_playback(TrajectoryPlayer &player, double seconds);
+
+// Copy the current frame into positions once decoded, never waits for decoding.
+// True when a new frame was uploaded, its body count is then in shown_count.
+bool update_trajectory_player(TrajectoryPlayer &player, GLuint positions_and_masses);
@@ -0,0 +1,180 @@
+#include "tree.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+// Spread the 21 low bits of v three bits apart
+[[nodiscard]]
+static uint64_t spread_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffff;
+    v = (v | v << 16) & 0x1f0000ff0000ff;
+    v = (v | v << 8) & 0x100f00f00f00f00f;
+    v = (v | v << 4) & 0x10c30c30c30c30c3;
+    v = (v | v << 2) & 0x1249249249249249;
+    return v;
+}
+
+// Nodes of bodies [begin, end) of codes, the octant of a body at level depth is given by its code bits
+static void build_node(Octree &tree, const std::vector<uint64_t> &codes, uint32_t begin, uint32_t end, uint32_t depth, float size)
+{
+    std::size_t index = tree.nodes.size();
+    tree.nodes.push_back({});
+
+    glm::dvec3 weighted_position(0.0);
+    double mass = 0.0;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        weighted_position += glm::dvec3(tree.bodies[i]) * static_cast<double>(tree.bodies[i].w);
+        mass += tree.bodies[i].w;
+    }
+    glm::vec3 center = mass > 0.0 ? glm::vec3(weighted_position / mass) : glm::vec3(tree.bodies[begin]);
+
+    if (end - begin > Octree::LEAF_SIZE && depth < Octree::MAX_DEPTH)
+    {
+        // Codes are sorted and share their bits above this level, so the octants are consecutive ranges
+        uint32_t shift = 3 * (Octree::MAX_DEPTH - 1 - depth);
+        uint32_t child_begin = begin;
+        for (uint64_t octant = 0; octant < 8 && child_begin < end; ++octant)
+        {
+            auto it = std::upper_bound(codes.begin() + child_begin, codes.begin() + end, octant,
+                                       [shift](uint64_t value, uint64_t code) { return value < ((code >> shift) & 7); });
+            uint32_t child_end = static_cast<uint32_t>(it - codes.begin());
+            if (child_end > child_begin)
+            {
+                build_node(tree, codes, child_begin, child_end, depth + 1, 0.5f * size);
+            }
+            child_begin = child_end;
+        }
+    }
+
+    OctreeNode &node = tree.nodes[index];
+    node.center_of_mass = glm::vec4(center, static_cast<float>(mass));
+    node.size = size;
+    node.begin = begin;
+    node.end = end;
+    node.skip = static_cast<uint32_t>(tree.nodes.size());
+}
+
+void build_octree(Octree &tree, std::span<const glm::vec4> positions_and_masses)
+{
+    std::size_t count = positions_and_masses.size();
+    tree.nodes.clear();
+    tree.bodies.resize(count);
+    tree.order.resize(count);
+    if (count == 0)
+    {
+        return;
+    }
+
+    glm::vec3 lower(std::numeric_limits<float>::max());
+    glm::vec3 upper(std::numeric_limits<float>::lowest());
+    for (const glm::vec4 &body : positions_and_masses)
+    {
+        lower = glm::min(lower, glm::vec3(body));
+        upper = glm::max(upper, glm::vec3(body));
+    }
+    glm::vec3 extent = upper - lower;
+    float size = std::max({extent.x, extent.y, extent.z, 1e-6f}) * 1.0001f;
+
+    // Morton code of every body, sorted with the body index
+    constexpr float CELLS = static_cast<float>(1u << Octree::MAX_DEPTH);
+    std::vector<std::pair<uint64_t, uint32_t>> keys(count);
+    parallel_for(count, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 cell = glm::min(glm::max((glm::vec3(positions_and_masses[i]) - lower) / size * CELLS, glm::vec3(0.0f)), glm::vec3(CELLS - 1.0f));
+            uint64_t code = spread_bits(static_cast<uint64_t>(cell.x)) << 2 | spread_bits(static_cast<uint64_t>(cell.y)) << 1 | spread_bits(static_cast<uint64_t>(cell.z));
+            keys[i] = {code, static_cast<uint32_t>(i)};
+        }
+    });
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint64_t> codes(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        codes[i] = keys[i].first;
+        tree.order[i] = keys[i].second;
+        tree.bodies[i] = positions_and_masses[keys[i].second];
+    }
+
+    build_node(tree, codes, 0, static_cast<uint32_t>(count), 0, size);
+}
+
+glm::vec3 octree_acceleration(const Octree &tree, glm::vec3 position, float theta, float gravity, float softening, std::size_t &interactions)
+{
+    float theta_sq = theta * theta;
+    float eps_sq = softening * softening;
+    glm::vec3 acceleration(0.0f);
+
+    // The softened force of a body on itself is zero, it needs no special case
+    auto add = [&](const glm::vec4 &source)
+    {
+        glm::vec3 dpos = glm::vec3(source) - position;
+        float distance_sq = glm::dot(dpos, dpos) + eps_sq;
+        float inv_r = 1.0f / std::sqrt(distance_sq);
+        acceleration += (source.w * inv_r * inv_r * inv_r) * dpos;
+    };
+
+    std::size_t i = 0;
+    while (i < tree.nodes.size())
+    {
+        const OctreeNode &node = tree.nodes[i];
+        bool leaf = node.skip == i + 1;
+        glm::vec3 dpos = glm::vec3(node.center_of_mass) - position;
+
+        if (node.size * node.size < theta_sq * glm::dot(dpos, dpos))
+        {
+            add(node.center_of_mass);
+            ++interactions;
+            i = node.skip;
+        }
+        else if (leaf)
+        {
+            for (uint32_t j = node.begin; j < node.end; ++j)
+            {
+                add(tree.bodies[j]);
+            }
+            interactions += node.end - node.begin;
+            i = node.skip;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    return gravity * acceleration;
+}
+
+std::size_t step_tree(std::span<glm::vec4> positions_and_masses, std::span<glm::vec4> velocities, float dt, float gravity,
+                      float softening, float theta, Octree &tree, std::vector<glm::vec4> &scratch)
+{
+    build_octree(tree, positions_and_masses);
+    scratch.resize(positions_and_masses.size());
+    std::atomic<std::size_t> total_interactions = 0;
+
+    // Bodies in Morton order, neighbouring bodies walk the same nodes
+    parallel_for(tree.bodies.size(), [&](std::size_t begin, std::size_t end)
+    {
+        std::size_t interactions = 0;
+        for (std::size_t sorted = begin; sorted < end; ++sorted)
+        {
+            uint32_t i = tree.order[sorted];
+            glm::vec3 position(tree.bodies[sorted]);
+            glm::vec3 acceleration = octree_acceleration(tree, position, theta, gravity, softening, interactions);
+
+            glm::vec3 velocity = glm::vec3(velocities[i]) + acceleration * dt;
+            velocities[i] = glm::vec4(velocity, velocities[i].w);
+            scratch[i] = glm::vec4(position + velocity * dt, positions_and_masses[i].w);
+        }
+        total_interactions += interactions;
+    });
+
+    std::copy(scratch.begin(), scratch.end(), positions_and_masses.begin());
+    return total_interactions;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+CPU Barnes-Hut backend. Bodies are sorted along a Morton curve and grouped in an octree whose nodes
+hold the mass and center of mass of their bodies. A node of size s at distance d from a body acts as a
+single point mass when s < theta * d, theta = 0 gives back the direct sum.
+Nodes are stored depth first: the first child of a node follows it, skip is the node after its subtree,
+so the tree is walked without a stack.
+*/
+
+struct OctreeNode
+{
+    glm::vec4 center_of_mass{0.0f}; // x, y, z, mass
+    float size = 0.0f;              // edge of the cube
+    uint32_t begin = 0;             // bodies of the node in Morton order
+    uint32_t end = 0;
+    uint32_t skip = 0;
+};
+
+struct Octree
+{
+    static constexpr std::size_t LEAF_SIZE = 8;
+    static constexpr uint32_t MAX_DEPTH = 21; // bits per axis of the Morton codes
+
+    std::vector<OctreeNode> nodes;
+    std::vector<glm::vec4> bodies; // positions and masses in Morton order
+    std::vector<uint32_t> order;   // index in the input of each sorted body
+};
+
+void build_octree(Octree &tree, std::span<const glm::vec4> positions_and_masses);
+
+// Softened acceleration at position, interactions is increased by the nodes and bodies summed
+[[nodiscard]]
+glm::vec3 octree_acceleration(const Octree &tree, glm::vec3 position, float theta, float gravity, float softening, std::size_t &interactions);
+
+// One symplectic Euler step like step_direct, with the accelerations from the octree.
+// scratch holds the new positions. Returns the interactions summed over every body.
+std::size_t step_tree(std::span<glm::vec4> positions_and_masses, std::span<glm::vec4> velocities, float dt, float gravity,
+                      float softening, float theta, Octree &tree, std::vector<glm::vec4> &scratch);
@@ -0,0 +1,663 @@
+#include "validation.hpp"
+#include "diagnostics.hpp"
+#include "ensemble.hpp"
+#include "error_log.hpp"
+#include "gl_resources.hpp"
+#include "gravity.hpp"
+#include "merging.hpp"
+#include "parallel.hpp"
+#include "potential.hpp"
+#include "precision.hpp"
+#include "scene.hpp"
+#include "shader.hpp"
+#include "simulation_parameters.hpp"
+#include "step_batch.hpp"
+#include "tree.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+#include <glm/glm.hpp>
+
+static const std::filesystem::path COMPUTE_SHADER_FILEPATH = "../shaders/compute.glsl";
+
+// Bodies of every check. With VALIDATION_BATCH_STEPS steps per batch and one workgroup the persistent
+// kernel stays below the loop limit of llvmpipe, so the GLSL backends can be validated without a GPU.
+// The throughput baseline is only comparable for this configuration.
+static constexpr std::size_t VALIDATION_COUNT = 1024;
+static constexpr std::size_t VALIDATION_BATCH_STEPS = 4;
+static constexpr GLuint VALIDATION_PERSISTENT_GROUPS = 1;
+static constexpr std::size_t DRIFT_STEPS = 100;
+
+// Error bounds of a backend
+struct Tolerances
+{
+    double force_rms = 0.0;
+    double force_max = 0.0;
+    double energy = 0.0;   // |E - E_reference| / |E_start| after DRIFT_STEPS
+    double momentum = 0.0; // |P - P_start| / sum(m |v|) after DRIFT_STEPS
+};
+
+// About ten times what the fp32 direct sums reach on these scenes
+static constexpr Tolerances DIRECT_TOLERANCES = {2e-5, 1e-4, 3e-5, 5e-6};
+
+// The tree approximates distant nodes and its forces are not symmetric, so momentum drifts as well.
+// About five times what it reaches at VALIDATION_THETA.
+static constexpr float VALIDATION_THETA = 0.3f;
+static constexpr Tolerances TREE_TOLERANCES = {2e-2, 5e-2, 1e-4, 5e-3};
+
+// Throughput runs double their steps until they last long enough to time
+static constexpr double THROUGHPUT_MIN_SECONDS = 0.5;
+static constexpr std::size_t THROUGHPUT_MAX_STEPS = 1 << 16;
+
+using Clock = std::chrono::steady_clock;
+
+// State advanced by a backend, in and out
+struct Bodies
+{
+    std::vector<glm::vec4> positions_and_masses;
+    std::vector<glm::vec4> velocities;
+};
+
+// Advance the bodies by steps steps of dt, returns the seconds spent stepping, empty if the backend failed
+using BackendStep = std::function<std::optional<double>(Bodies &bodies, std::size_t steps, float dt)>;
+
+struct ForceBackend
+{
+    std::string name;
+    BackendStep step;
+    Tolerances tolerances = DIRECT_TOLERANCES;
+};
+
+// Scene of the accuracy checks with its double precision reference
+struct ReferenceScene
+{
+    std::string name;
+    Bodies bodies;
+    std::vector<glm::dvec3> accelerations;
+    float initial_energy = 0.0f;
+    float final_energy = 0.0f; // after DRIFT_STEPS
+    glm::vec3 initial_momentum{0.0f};
+    double momentum_scale = 0.0;
+};
+
+// Programs and buffers shared by the GLSL backends
+struct GpuBackends
+{
+    Program compute_program;
+    UniformRing parameters;
+    StepBatcher batcher;
+    RelativeIntegrator relative;
+    PotentialKernel potential;
+};
+
+[[nodiscard]]
+static double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+[[nodiscard]]
+static GLuint num_groups(GLuint count)
+{
+    return (count + StepBatcher::WORKGROUP_SIZE - 1) / StepBatcher::WORKGROUP_SIZE;
+}
+
+// Symplectic Euler in double precision, the update of every backend
+static void reference_steps(std::vector<glm::dvec4> &positions_and_masses, std::vector<glm::dvec3> &velocities, std::size_t steps, double dt)
+{
+    double eps_sq = static_cast<double>(Scene::SOFTENING) * Scene::SOFTENING;
+    std::vector<glm::dvec3> next_positions(positions_and_masses.size());
+
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        parallel_for(positions_and_masses.size(), [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                glm::dvec3 position(positions_and_masses[i]);
+                glm::dvec3 acceleration(0.0);
+
+                for (std::size_t j = 0; j < positions_and_masses.size(); ++j)
+                {
+                    if (i == j)
+                    {
+                        continue;
+                    }
+
+                    glm::dvec3 dpos = glm::dvec3(positions_and_masses[j]) - position;
+                    double inv_r = 1.0 / std::sqrt(glm::dot(dpos, dpos) + eps_sq);
+                    acceleration += (positions_and_masses[j].w * inv_r * inv_r * inv_r) * dpos;
+                }
+
+                velocities[i] += static_cast<double>(Scene::GRAVITY) * acceleration * dt;
+                next_positions[i] = position + velocities[i] * dt;
+            }
+        });
+
+        for (std::size_t i = 0; i < positions_and_masses.size(); ++i)
+        {
+            positions_and_masses[i] = glm::dvec4(next_positions[i], positions_and_masses[i].w);
+        }
+    }
+}
+
+[[nodiscard]]
+static ReferenceScene make_reference_scene(std::string name, const Scene &scene)
+{
+    ReferenceScene reference;
+    reference.name = std::move(name);
+    reference.bodies = {scene.positions_and_masses, scene.velocities};
+
+    std::size_t count = scene.count();
+    reference.accelerations.assign(count, glm::dvec3(0.0));
+    accumulate_accelerations(scene.positions_and_masses, 0, scene.positions_and_masses, 0, Scene::GRAVITY, Scene::SOFTENING, reference.accelerations);
+
+    Diagnostics initial = compute_diagnostics(scene.positions_and_masses, scene.velocities, Scene::GRAVITY, Scene::SOFTENING);
+    reference.initial_energy = initial.total_energy();
+    reference.initial_momentum = initial.momentum;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        reference.momentum_scale += scene.positions_and_masses[i].w * glm::length(glm::dvec3(scene.velocities[i]));
+    }
+
+    std::vector<glm::dvec4> positions(scene.positions_and_masses.begin(), scene.positions_and_masses.end());
+    std::vector<glm::dvec3> velocities(count);
+    std::transform(scene.velocities.begin(), scene.velocities.end(), velocities.begin(), [](const glm::vec4 &v) { return glm::dvec3(v); });
+    reference_steps(positions, velocities, DRIFT_STEPS, Scene::DT);
+
+    Bodies final_bodies;
+    std::transform(positions.begin(), positions.end(), std::back_inserter(final_bodies.positions_and_masses), [](const glm::dvec4 &p) { return glm::vec4(p); });
+    std::transform(velocities.begin(), velocities.end(), std::back_inserter(final_bodies.velocities), [](const glm::dvec3 &v) { return glm::vec4(glm::vec3(v), 0.0f); });
+    reference.final_energy = compute_diagnostics(final_bodies.positions_and_masses, final_bodies.velocities, Scene::GRAVITY, Scene::SOFTENING).total_energy();
+
+    return reference;
+}
+
+[[nodiscard]]
+static std::optional<double> step_cpu_direct(Bodies &bodies, std::size_t steps, float dt)
+{
+    std::vector<glm::vec4> scratch;
+    Clock::time_point start = Clock::now();
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        step_direct(bodies.positions_and_masses, bodies.velocities, dt, Scene::GRAVITY, Scene::SOFTENING, scratch);
+    }
+    return seconds_since(start);
+}
+
+[[nodiscard]]
+static std::optional<double> step_cpu_parallel(Bodies &bodies, std::size_t steps, float dt)
+{
+    std::vector<glm::vec4> scratch;
+    Clock::time_point start = Clock::now();
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        step_direct_parallel(bodies.positions_and_masses, bodies.velocities, dt, Scene::GRAVITY, Scene::SOFTENING, scratch);
+    }
+    return seconds_since(start);
+}
+
+[[nodiscard]]
+static std::optional<double> step_cpu_tree(Bodies &bodies, std::size_t steps, float dt)
+{
+    Octree tree;
+    std::vector<glm::vec4> scratch;
+    Clock::time_point start = Clock::now();
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        step_tree(bodies.positions_and_masses, bodies.velocities, dt, Scene::GRAVITY, Scene::SOFTENING, VALIDATION_THETA, tree, scratch);
+    }
+    return seconds_since(start);
+}
+
+// compute.glsl, one dispatch per step or batched like the main loop
+[[nodiscard]]
+static std::optional<double> step_glsl(GpuBackends &gpu, StepMode mode, Bodies &bodies, std::size_t steps, float dt)
+{
+    GLuint count = static_cast<GLuint>(bodies.positions_and_masses.size());
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    std::array<Buffer, 2> positions = {make_buffer(size, bodies.positions_and_masses.data(), 0), make_buffer(size, nullptr, 0)};
+    Buffer velocities = make_buffer(size, bodies.velocities.data(), 0);
+    Buffer colors = make_buffer(size, nullptr, 0);
+    BindingSets binding_sets = {{{positions[0].get(), velocities.get(), colors.get(), positions[1].get()},
+                                 {positions[1].get(), velocities.get(), colors.get(), positions[0].get()}}};
+    LiveCount live_count = make_live_count(count);
+    Buffer live_count_buffer = make_buffer(sizeof(LiveCount), &live_count, 0);
+
+    SimulationParameters parameters;
+    parameters.count = count;
+    parameters.dt = dt;
+    parameters.gravity = Scene::GRAVITY;
+    parameters.softening = Scene::SOFTENING;
+    parameters.iter_per_frame = 1;
+
+    std::size_t parity = 0;
+    glFinish();
+    Clock::time_point start = Clock::now();
+
+    for (std::size_t done = 0; done < steps;)
+    {
+        std::size_t batch = mode == StepMode::PerStep ? 1 : std::min(VALIDATION_BATCH_STEPS, steps - done);
+        if (parameters.step_count != batch || done == 0)
+        {
+            parameters.step_count = static_cast<GLuint>(batch);
+            update_uniform_ring(gpu.parameters, parameters);
+        }
+
+        switch (mode)
+        {
+        case StepMode::PerStep:
+            glUseProgram(gpu.compute_program.get());
+            glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, 0, 4, binding_sets[parity].data());
+            glDispatchCompute(num_groups(count), 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            break;
+        case StepMode::Indirect:
+            queue_indirect_steps(gpu.compute_program.get(), live_count_buffer.get(), binding_sets, parity, batch);
+            break;
+        case StepMode::Persistent:
+            if (!run_persistent_steps(gpu.batcher, binding_sets, parity, count))
+            {
+                log_error(ErrorType::Validation, "The persistent kernel gave up on its grid barrier");
+                return std::nullopt;
+            }
+            break;
+        }
+
+        parity = (parity + batch) % 2;
+        done += batch;
+    }
+
+    glFinish();
+    double seconds = seconds_since(start);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetNamedBufferSubData(positions[parity].get(), 0, size, bodies.positions_and_masses.data());
+    glGetNamedBufferSubData(velocities.get(), 0, size, bodies.velocities.data());
+    return seconds;
+}
+
+// compute_potential.glsl, one dispatch per step. energies, if given, receives those of the last step.
+[[nodiscard]]
+static std::optional<double> step_glsl_potential(GpuBackends &gpu, Bodies &bodies, std::size_t steps, float dt, std::vector<glm::vec2> *energies = nullptr)
+{
+    GLuint count = static_cast<GLuint>(bodies.positions_and_masses.size());
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    std::array<Buffer, 2> positions = {make_buffer(size, bodies.positions_and_masses.data(), 0), make_buffer(size, nullptr, 0)};
+    Buffer velocities = make_buffer(size, bodies.velocities.data(), 0);
+    Buffer colors = make_buffer(size, nullptr, 0);
+    BindingSets binding_sets = {{{positions[0].get(), velocities.get(), colors.get(), positions[1].get()},
+                                 {positions[1].get(), velocities.get(), colors.get(), positions[0].get()}}};
+
+    SimulationParameters parameters;
+    parameters.count = count;
+    parameters.dt = dt;
+    parameters.gravity = Scene::GRAVITY;
+    parameters.softening = Scene::SOFTENING;
+    parameters.iter_per_frame = 1;
+    update_uniform_ring(gpu.parameters, parameters);
+
+    std::size_t parity = 0;
+    glFinish();
+    Clock::time_point start = Clock::now();
+
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        dispatch_potential_step(gpu.potential, binding_sets, parity, count);
+        parity = 1 - parity;
+    }
+
+    glFinish();
+    double seconds = seconds_since(start);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetNamedBufferSubData(positions[parity].get(), 0, size, bodies.positions_and_masses.data());
+    glGetNamedBufferSubData(velocities.get(), 0, size, bodies.velocities.data());
+    if (energies)
+    {
+        energies->resize(count);
+        glGetNamedBufferSubData(gpu.potential.energies.get(), 0, static_cast<GLsizeiptr>(count * sizeof(glm::vec2)), energies->data());
+    }
+    return seconds;
+}
+
+[[nodiscard]]
+static std::optional<double> step_glsl_relative(GpuBackends &gpu, Bodies &bodies, std::size_t steps, float dt)
+{
+    GLuint count = static_cast<GLuint>(bodies.positions_and_masses.size());
+    GLsizeiptr size = static_cast<GLsizeiptr>(count * sizeof(glm::vec4));
+    std::array<Buffer, 2> positions = {make_buffer(size, bodies.positions_and_masses.data(), 0),
+                                       make_buffer(size, bodies.positions_and_masses.data(), 0)};
+    Buffer velocities = make_buffer(size, bodies.velocities.data(), 0);
+
+    glFinish();
+    Clock::time_point start = Clock::now();
+
+    split_positions(gpu.relative, positions[0].get(), count);
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        step_relative(gpu.relative, positions[1].get(), velocities.get(), count, dt, Scene::GRAVITY, Scene::SOFTENING);
+    }
+
+    glFinish();
+    double seconds = seconds_since(start);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetNamedBufferSubData(positions[1].get(), 0, size, bodies.positions_and_masses.data());
+    glGetNamedBufferSubData(velocities.get(), 0, size, bodies.velocities.data());
+    return seconds;
+}
+
+// ensemble.glsl with a single member
+[[nodiscard]]
+static std::optional<double> step_glsl_ensemble(Bodies &bodies, std::size_t steps, float dt)
+{
+    Ensemble ensemble;
+    ensemble.count = bodies.positions_and_masses.size();
+    ensemble.members = {EnsembleMember{0, Scene::GRAVITY, Scene::SOFTENING}};
+    ensemble.positions_and_masses = std::move(bodies.positions_and_masses);
+    ensemble.velocities = std::move(bodies.velocities);
+
+    EnsembleStats stats = run_ensemble_gpu(ensemble, steps, dt);
+
+    bodies.positions_and_masses = std::move(ensemble.positions_and_masses);
+    bodies.velocities = std::move(ensemble.velocities);
+    if (stats.seconds <= 0.0)
+    {
+        return std::nullopt;
+    }
+    return stats.seconds;
+}
+
+[[nodiscard]]
+static ValidationCheck check_force(const ForceBackend &backend, const ReferenceScene &scene)
+{
+    ValidationCheck check;
+    check.name = std::format("force/{}/{}", backend.name, scene.name);
+
+    // From rest with dt = 1 the velocities after one step are the accelerations
+    Bodies bodies{scene.bodies.positions_and_masses, std::vector<glm::vec4>(scene.bodies.velocities.size(), glm::vec4(0.0f))};
+    if (!backend.step(bodies, 1, 1.0f))
+    {
+        check.detail = "backend failed";
+        return check;
+    }
+
+    double max_error = 0.0;
+    double sum_sq = 0.0;
+    for (std::size_t i = 0; i < scene.accelerations.size(); ++i)
+    {
+        const glm::dvec3 &reference = scene.accelerations[i];
+        double error = glm::length(glm::dvec3(bodies.velocities[i]) - reference) / std::max(glm::length(reference), 1e-30);
+        max_error = std::max(max_error, error);
+        sum_sq += error * error;
+    }
+    double rms_error = std::sqrt(sum_sq / static_cast<double>(scene.accelerations.size()));
+
+    // NaN fails both comparisons
+    const Tolerances &tolerances = backend.tolerances;
+    check.passed = rms_error <= tolerances.force_rms && max_error <= tolerances.force_max;
+    check.detail = std::format("rms {:.3e} (max {:.0e}) | max {:.3e} (max {:.0e})", rms_error, tolerances.force_rms, max_error, tolerances.force_max);
+    return check;
+}
+
+[[nodiscard]]
+static ValidationCheck check_drift(const ForceBackend &backend, const ReferenceScene &scene)
+{
+    ValidationCheck check;
+    check.name = std::format("drift/{}/{}", backend.name, scene.name);
+
+    Bodies bodies = scene.bodies;
+    if (!backend.step(bodies, DRIFT_STEPS, Scene::DT))
+    {
+        check.detail = "backend failed";
+        return check;
+    }
+
+    Diagnostics final_diagnostics = compute_diagnostics(bodies.positions_and_masses, bodies.velocities, Scene::GRAVITY, Scene::SOFTENING);
+    double energy_error = std::abs(static_cast<double>(final_diagnostics.total_energy()) - scene.final_energy) / std::abs(static_cast<double>(scene.initial_energy));
+    double momentum_error = glm::length(glm::dvec3(final_diagnostics.momentum) - glm::dvec3(scene.initial_momentum)) / scene.momentum_scale;
+
+    const Tolerances &tolerances = backend.tolerances;
+    check.passed = energy_error <= tolerances.energy && momentum_error <= tolerances.momentum;
+    check.detail = std::format("energy {:.3e} (max {:.0e}) | momentum {:.3e} (max {:.0e})", energy_error, tolerances.energy, momentum_error, tolerances.momentum);
+    return check;
+}
+
+// compute_potential.glsl with adaptive softening lengths, against a double precision sum with the same
+// pair softening: the accelerations and the potential of every body
+[[nodiscard]]
+static ValidationCheck check_potential(GpuBackends &gpu, const ReferenceScene &scene)
+{
+    ValidationCheck check;
+    check.name = std::format("potential/glsl-potential/{}", scene.name);
+
+    std::size_t count = scene.bodies.positions_and_masses.size();
+    Bodies bodies{scene.bodies.positions_and_masses, std::vector<glm::vec4>(count, glm::vec4(0.0f))};
+    Octree tree;
+    build_octree(tree, bodies.positions_and_masses);
+    assign_softening_lengths(tree, Scene::ADAPTIVE_SOFTENING_FACTOR, Scene::SOFTENING, Scene::ADAPTIVE_SOFTENING_MAX, bodies.velocities);
+
+    std::vector<glm::dvec3> accelerations(count);
+    std::vector<double> potentials(count);
+    accumulate_softened_potentials(bodies.positions_and_masses, bodies.velocities, Scene::GRAVITY, Scene::SOFTENING, accelerations, potentials);
+
+    // From rest with dt = 1 the velocities after one step are the accelerations
+    std::vector<glm::vec2> energies;
+    if (!step_glsl_potential(gpu, bodies, 1, 1.0f, &energies))
+    {
+        check.detail = "backend failed";
+        return check;
+    }
+
+    double max_force_error = 0.0;
+    double max_potential_error = 0.0;
+    double sum_sq = 0.0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double force_error = glm::length(glm::dvec3(bodies.velocities[i]) - accelerations[i]) / std::max(glm::length(accelerations[i]), 1e-30);
+        double potential_error = std::abs(energies[i].x - potentials[i]) / std::max(std::abs(potentials[i]), 1e-30);
+        max_force_error = std::max(max_force_error, force_error);
+        max_potential_error = std::max(max_potential_error, potential_error);
+        sum_sq += force_error * force_error;
+    }
+    double rms_force_error = std::sqrt(sum_sq / static_cast<double>(count));
+
+    // The potential is a sum of positive terms, it rounds like the largest force errors at most
+    check.passed = rms_force_error <= DIRECT_TOLERANCES.force_rms && max_force_error <= DIRECT_TOLERANCES.force_max &&
+                   max_potential_error <= DIRECT_TOLERANCES.force_max;
+    check.detail = std::format("force rms {:.3e} (max {:.0e}) | force max {:.3e} (max {:.0e}) | potential max {:.3e} (max {:.0e})",
+                               rms_force_error, DIRECT_TOLERANCES.force_rms, max_force_error, DIRECT_TOLERANCES.force_max,
+                               max_potential_error, DIRECT_TOLERANCES.force_max);
+    return check;
+}
+
+// Steps/s on the pinned body count, empty if the backend failed
+[[nodiscard]]
+static std::optional<double> measure_throughput(const ForceBackend &backend, const Bodies &initial)
+{
+    for (std::size_t steps = 4;; steps *= 2)
+    {
+        Bodies bodies = initial;
+        std::optional<double> seconds = backend.step(bodies, steps, Scene::DT);
+        if (!seconds)
+        {
+            return std::nullopt;
+        }
+        if (*seconds >= THROUGHPUT_MIN_SECONDS || steps >= THROUGHPUT_MAX_STEPS)
+        {
+            return static_cast<double>(steps) / std::max(*seconds, 1e-9);
+        }
+    }
+}
+
+std::optional<ThroughputBaseline> read_throughput_baseline(const std::filesystem::path &filepath)
+{
+    ThroughputBaseline baseline;
+    std::ifstream file(filepath);
+    if (!file)
+    {
+        log_error(ErrorType::Validation, std::format("Cannot open baseline {}", filepath.string()));
+        return std::nullopt;
+    }
+
+    std::string line;
+    for (std::size_t line_number = 1; std::getline(file, line); ++line_number)
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        std::string name;
+        double steps_per_second = 0.0;
+        if (!(stream >> name))
+        {
+            continue;
+        }
+        if (!(stream >> steps_per_second) || steps_per_second <= 0.0)
+        {
+            log_error(ErrorType::Validation, std::format("{}:{}: expected '<backend> <steps/s>'", filepath.string(), line_number));
+            return std::nullopt;
+        }
+        baseline[name] = steps_per_second;
+    }
+
+    return baseline;
+}
+
+bool write_throughput_baseline(const std::filesystem::path &filepath, const ThroughputBaseline &baseline)
+{
+    std::ofstream file(filepath);
+    if (!file)
+    {
+        log_error(ErrorType::Validation, std::format("Cannot write baseline {}", filepath.string()));
+        return false;
+    }
+
+    file << std::format("# steps/s with {} bodies, written by --validate --update-baseline\n", VALIDATION_COUNT);
+    for (const auto &[name, steps_per_second] : baseline)
+    {
+        file << std::format("{} {:.3f}\n", name, steps_per_second);
+    }
+    return static_cast<bool>(file);
+}
+
+std::optional<std::vector<ValidationCheck>> run_validation(const ValidationSettings &settings)
+{
+    // A baseline being written may not exist yet
+    std::optional<ThroughputBaseline> baseline = ThroughputBaseline{};
+    if (!settings.baseline_path.empty() && !(settings.update_baseline && !std::filesystem::exists(settings.baseline_path)))
+    {
+        baseline = read_throughput_baseline(settings.baseline_path);
+        if (!baseline)
+        {
+            return std::nullopt;
+        }
+    }
+
+    GpuBackends gpu;
+    std::vector<ForceBackend> backends;
+    backends.push_back({"cpu-direct", step_cpu_direct});
+    backends.push_back({"cpu-parallel", step_cpu_parallel});
+    backends.push_back({"cpu-tree", step_cpu_tree, TREE_TOLERANCES});
+
+    if (settings.gpu)
+    {
+        gpu.compute_program.reset(make_compute_shader_program(COMPUTE_SHADER_FILEPATH));
+        gpu.parameters = make_uniform_ring(sizeof(SimulationParameters), SIMULATION_PARAMETERS_BINDING);
+        gpu.batcher = make_step_batcher(VALIDATION_COUNT, VALIDATION_PERSISTENT_GROUPS);
+        gpu.relative = make_relative_integrator(VALIDATION_COUNT);
+        gpu.potential = make_potential_kernel(VALIDATION_COUNT);
+        if (!gpu.compute_program || !gpu.batcher.persistent_program || !gpu.relative.program || !gpu.potential.program)
+        {
+            return std::nullopt;
+        }
+
+        for (StepMode mode : {StepMode::PerStep, StepMode::Indirect, StepMode::Persistent})
+        {
+            backends.push_back({std::format("glsl-{}", step_mode_to_string(mode)),
+                                [&gpu, mode](Bodies &bodies, std::size_t steps, float dt) { return step_glsl(gpu, mode, bodies, steps, dt); }});
+        }
+        backends.push_back({"glsl-potential", [&gpu](Bodies &bodies, std::size_t steps, float dt) { return step_glsl_potential(gpu, bodies, steps, dt); }});
+        backends.push_back({"glsl-relative", [&gpu](Bodies &bodies, std::size_t steps, float dt) { return step_glsl_relative(gpu, bodies, steps, dt); }});
+        backends.push_back({"glsl-ensemble", step_glsl_ensemble});
+    }
+
+    std::vector<ReferenceScene> scenes;
+    scenes.push_back(make_reference_scene("sun_collapse", create_sun_collapse(42, VALIDATION_COUNT)));
+    scenes.push_back(make_reference_scene("galaxy_bh", create_galaxy_bh_scene(42, VALIDATION_COUNT)));
+    scenes.push_back(make_reference_scene("galaxy_collision", create_galaxy_collision_scene(42, VALIDATION_COUNT)));
+
+    std::vector<ValidationCheck> checks;
+    for (const ForceBackend &backend : backends)
+    {
+        for (const ReferenceScene &scene : scenes)
+        {
+            checks.push_back(check_force(backend, scene));
+            checks.push_back(check_drift(backend, scene));
+        }
+    }
+
+    if (settings.gpu)
+    {
+        for (const ReferenceScene &scene : scenes)
+        {
+            checks.push_back(check_potential(gpu, scene));
+        }
+    }
+
+    ThroughputBaseline measured;
+    for (const ForceBackend &backend : backends)
+    {
+        ValidationCheck check;
+        check.name = std::format("throughput/{}", backend.name);
+
+        std::optional<double> steps_per_second = measure_throughput(backend, scenes.front().bodies);
+        if (!steps_per_second)
+        {
+            check.detail = "backend failed";
+            checks.push_back(std::move(check));
+            continue;
+        }
+        measured[backend.name] = *steps_per_second;
+
+        // Without a baseline file throughput is only reported, with one every backend needs an entry
+        auto it = baseline->find(backend.name);
+        if (settings.update_baseline || settings.baseline_path.empty())
+        {
+            check.passed = true;
+            check.detail = std::format("{:.1f} steps/s | {}", *steps_per_second, settings.update_baseline ? "baseline updated" : "no baseline");
+        }
+        else if (it == baseline->end())
+        {
+            check.detail = std::format("{:.1f} steps/s | no entry in {}", *steps_per_second, settings.baseline_path.string());
+        }
+        else
+        {
+            double change = *steps_per_second / it->second - 1.0;
+            check.passed = change >= -settings.throughput_tolerance;
+            check.detail = std::format("{:.1f} steps/s | baseline {:.1f} ({:+.1f}%, min {:.0f}%)",
+                                       *steps_per_second, it->second, 100.0 * change, -100.0 * settings.throughput_tolerance);
+        }
+        checks.push_back(std::move(check));
+    }
+
+    if (settings.update_baseline && !settings.baseline_path.empty())
+    {
+        // Backends missing from this run, such as the GLSL ones without a context, keep their entry
+        for (const auto &[name, steps_per_second] : measured)
+        {
+            (*baseline)[name] = steps_per_second;
+        }
+        if (!write_throughput_baseline(settings.baseline_path, *baseline))
+        {
+            return std::nullopt;
+        }
+    }
+
+    return checks;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+
+/*
+Regression checks of the force backends, run with --validate.
+Accuracy: every backend against a double precision direct sum on the built-in scenes, for a single
+force evaluation and for the energy and momentum after a fixed number of steps.
+Throughput: steps/s of every backend at a pinned body count against a stored baseline.
+*/
+
+struct ValidationCheck
+{
+    std::string name;
+    bool passed = false;
+    std::string detail;
+};
+
+struct ValidationSettings
+{
+    bool gpu = false;                    // the GLSL backends need a current OpenGL context
+    std::filesystem::path baseline_path; // empty: throughput is reported but not checked
+    bool update_baseline = false;        // write the measured throughput to the baseline file
+    double throughput_tolerance = 0.2;   // allowed drop below the baseline, as a fraction
+};
+
+// Baseline file: one "<backend> <steps/s>" line per backend, # starts a comment
+using ThroughputBaseline = std::map<std::string, double>;
+
+[[nodiscard]]
+std::optional<ThroughputBaseline> read_throughput_baseline(const std::filesystem::path &filepath);
+
+[[nodiscard]]
+bool write_throughput_baseline(const std::filesystem::path &filepath, const ThroughputBaseline &baseline);
+
+[[nodiscard]]
+std::optional<std::vector<ValidationCheck>> run_validation(const ValidationSettings &settings);